@@ -0,0 +1,108 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that all die together. Memory is carved out of
+// large chunks and only released when the arena is reset or destroyed, so
+// objects allocated here must be trivially destructible.
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t current = reinterpret_cast<uintptr_t>(cursor);
+        uintptr_t aligned = (current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            newChunk(size + alignment);
+            current = reinterpret_cast<uintptr_t>(cursor);
+            aligned = (current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        }
+        cursor = reinterpret_cast<char *>(aligned + size);
+        used += size;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    template <typename T, typename... Args>
+    T *make(Args &&...args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+    }
+
+    template <typename T>
+    std::span<T> makeArray(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+        if (count == 0) {
+            return {};
+        }
+        T *data = static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; ++i) {
+            new (data + i) T();
+        }
+        return {data, count};
+    }
+
+    // Forgets every allocation but keeps the first chunk for reuse
+    void reset() {
+        if (chunks.size() > 1) {
+            chunks.erase(chunks.begin() + 1, chunks.end());
+        }
+        rewind();
+    }
+
+    // Forgets every allocation and keeps every chunk, for an arena that is
+    // filled to about the same size over and over
+    void rewind() {
+        current = 0;
+        if (!chunks.empty()) {
+            cursor = chunks.front().data.get();
+            limit = cursor + chunks.front().size;
+        }
+        used = 0;
+    }
+
+    // Bytes handed out to callers, excluding alignment padding
+    size_t bytesUsed() const { return used; }
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void newChunk(size_t minimumSize) {
+        // Chunks kept by rewind() come first; one too small for this
+        // allocation sits idle until the next rewind
+        while (cursor != nullptr && ++current < chunks.size()) {
+            if (chunks[current].size >= minimumSize) {
+                cursor = chunks[current].data.get();
+                limit = cursor + chunks[current].size;
+                return;
+            }
+        }
+        size_t size = minimumSize > chunkSize ? minimumSize : chunkSize;
+        chunks.push_back({std::make_unique<char[]>(size), size});
+        current = chunks.size() - 1;
+        cursor = chunks.back().data.get();
+        limit = cursor + size;
+    }
+
+    size_t chunkSize;
+    std::vector<Chunk> chunks;
+    size_t current = 0;  // Index of the chunk cursor points into
+    char *cursor = nullptr;
+    char *limit = nullptr;
+    size_t used = 0;
+};
+
+#endif // ARENA_H
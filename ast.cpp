@@ -0,0 +1,242 @@
+#include "ast.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+string binaryOperatorToString(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::ADD:
+            return "+";
+        case BinaryOperator::SUBTRACT:
+            return "-";
+        case BinaryOperator::MULTIPLY:
+            return "*";
+        case BinaryOperator::DIVIDE:
+            return "/";
+        default:
+            return "?";
+    }
+}
+
+static BinaryOperator binaryOperatorFor(CSTTerminalNodeType type) {
+    switch (type) {
+        case CSTTerminalNodeType::PLUS:
+            return BinaryOperator::ADD;
+        case CSTTerminalNodeType::MINUS:
+            return BinaryOperator::SUBTRACT;
+        case CSTTerminalNodeType::ASTERISK:
+            return BinaryOperator::MULTIPLY;
+        default:
+            return BinaryOperator::DIVIDE;
+    }
+}
+
+template <typename T>
+static T *makeNode(Arena &arena, ASTNodeKind kind) {
+    T *node = arena.make<T>();
+    node->kind = kind;
+    return node;
+}
+
+template <typename T>
+static span<T> copyToArena(Arena &arena, const vector<T> &items) {
+    span<T> result = arena.makeArray<T>(items.size());
+    copy(items.begin(), items.end(), result.begin());
+    return result;
+}
+
+// Every CST node leaves exactly one Value behind once all of its children
+// have been visited, so a node with n children finds their values in the
+// top n slots of the value stack.
+struct Value {
+    ASTExpression *expression = nullptr;
+    uint32_t symbol = SymbolTable::INVALID_SYMBOL;
+};
+
+ASTProgram *lowerToAST(CSTNode *root, Arena &arena, const SymbolTable &symbols) {
+    struct Frame {
+        CSTNode *node;
+        size_t nextChild;
+    };
+    vector<Frame> stack = {{root, 0}};
+    vector<Value> values;
+
+    // List items of the function being lowered. Parameters are always reduced
+    // before the body, so name lookups only ever look at the current function.
+    vector<ASTFunction *> functions;
+    vector<ASTParam> params;
+    vector<ASTReturn *> statements;
+
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        CSTNode *node = frame.node;
+        if (frame.nextChild < node->children.size()) {
+            stack.push_back({node->children[frame.nextChild++], 0});
+            continue;
+        }
+        stack.pop_back();
+
+        size_t childCount = node->children.size();
+        Value *children = values.data() + values.size() - childCount;
+        Value result;
+
+        switch (node->type) {
+            case CSTNodeType::TERMINAL: {
+                auto *terminal = static_cast<CSTTerminalNode *>(node);
+                if (terminal->type == CSTTerminalNodeType::IDENTIFIER) {
+                    result.symbol = terminal->symbol;
+                } else if (terminal->type == CSTTerminalNodeType::NUMBER) {
+                    auto *literal = makeNode<ASTIntLiteral>(arena, ASTNodeKind::INT_LITERAL);
+                    literal->value = (int32_t)terminal->integer;  // Range checked by the lexer
+                    result.expression = literal;
+                }
+                break;
+            }
+
+            case CSTNodeType::PARAMETER: {
+                // parameter: type IDENTIFIER
+                ASTParam param;
+                param.kind = ASTNodeKind::PARAM;
+                param.name = children[1].symbol;
+                params.push_back(param);
+                break;
+            }
+
+            case CSTNodeType::STATEMENT: {
+                // statement: RETURN expression SEMICOLON
+                auto *statement = makeNode<ASTReturn>(arena, ASTNodeKind::RETURN);
+                statement->value = children[1].expression;
+                statements.push_back(statement);
+                break;
+            }
+
+            case CSTNodeType::EXPRESSION:
+            case CSTNodeType::TERM: {
+                if (childCount == 1) {
+                    result = children[0];
+                    break;
+                }
+                auto *binaryOp = makeNode<ASTBinaryOp>(arena, ASTNodeKind::BINARY_OP);
+                binaryOp->op = binaryOperatorFor(static_cast<CSTTerminalNode *>(node->children[1])->type);
+                binaryOp->lhs = children[0].expression;
+                binaryOp->rhs = children[2].expression;
+                result.expression = binaryOp;
+                break;
+            }
+
+            case CSTNodeType::FACTOR: {
+                if (childCount == 3) {
+                    // factor: LEFT_PARENTHESIS expression RIGHT_PARENTHESIS
+                    result = children[1];
+                    break;
+                }
+                if (children[0].expression != nullptr) {
+                    result = children[0];
+                    break;
+                }
+                uint32_t name = children[0].symbol;
+                auto *varRef = makeNode<ASTVarRef>(arena, ASTNodeKind::VAR_REF);
+                varRef->name = name;
+                varRef->paramIndex = UINT32_MAX;
+                for (size_t i = 0; i < params.size(); ++i) {
+                    if (params[i].name == name) {
+                        varRef->paramIndex = i;
+                        break;
+                    }
+                }
+                if (varRef->paramIndex == UINT32_MAX) {
+                    throw runtime_error("Undeclared name: " + string(symbols.name(name)));
+                }
+                result.expression = varRef;
+                break;
+            }
+
+            case CSTNodeType::FUNCTION: {
+                auto *function = makeNode<ASTFunction>(arena, ASTNodeKind::FUNCTION);
+                function->name = children[1].symbol;
+                function->params = copyToArena(arena, params);
+                function->statements = copyToArena(arena, statements);
+                functions.push_back(function);
+                params.clear();
+                statements.clear();
+                break;
+            }
+
+            default:
+                // program, functionList, type, parameterList and statementList
+                // carry nothing beyond the list items collected above
+                break;
+        }
+
+        values.resize(values.size() - childCount);
+        values.push_back(result);
+    }
+
+    ASTProgram *program = arena.make<ASTProgram>();
+    program->functions = copyToArena(arena, functions);
+    return program;
+}
+
+// Prints one expression per line, indented by depth. An explicit stack keeps
+// a long chain of operators, which nests one level per operator, from
+// overflowing the call stack.
+static void printExpression(const ASTExpression *root, const SymbolTable &symbols, int level, string &out) {
+    vector<pair<const ASTExpression *, int>> pending = {{root, level}};
+    while (!pending.empty()) {
+        auto [expression, depth] = pending.back();
+        pending.pop_back();
+        out.append(2 * depth, ' ');  // Indentation for depth
+        switch (expression->kind) {
+            case ASTNodeKind::INT_LITERAL:
+                out += "IntLiteral: ";
+                out += to_string(static_cast<const ASTIntLiteral *>(expression)->value);
+                out += '\n';
+                break;
+            case ASTNodeKind::VAR_REF:
+                out += "VarRef: ";
+                out += symbols.name(static_cast<const ASTVarRef *>(expression)->name);
+                out += '\n';
+                break;
+            case ASTNodeKind::BINARY_OP: {
+                auto *binaryOp = static_cast<const ASTBinaryOp *>(expression);
+                out += "BinaryOp: ";
+                out += binaryOperatorToString(binaryOp->op);
+                out += '\n';
+                pending.push_back({binaryOp->rhs, depth + 1});
+                pending.push_back({binaryOp->lhs, depth + 1});
+                break;
+            }
+            default:
+                out += "UNKNOWN\n";
+                break;
+        }
+        if (out.size() >= 64 * 1024) {
+            cout.write(out.data(), out.size());
+            out.clear();
+        }
+    }
+}
+
+void printAST(const ASTProgram *program, const SymbolTable &symbols) {
+    string out;
+    for (const ASTFunction *function : program->functions) {
+        out += "Function: ";
+        out += symbols.name(function->name);
+        out += '\n';
+        for (const ASTParam &param : function->params) {
+            out += "  Param: ";
+            out += symbols.name(param.name);
+            out += '\n';
+        }
+        for (const ASTReturn *statement : function->statements) {
+            out += "  Return\n";
+            printExpression(statement->value, symbols, 2, out);
+        }
+    }
+    cout.write(out.data(), out.size());
+    cout.flush();
+}
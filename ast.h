@@ -0,0 +1,105 @@
+#ifndef AST_H
+#define AST_H
+
+#include <cstdint>
+#include <span>
+
+#include "arena.h"
+#include "cst.h"
+#include "symbol_table.h"
+
+// Typed AST for script_grammar. Nodes are allocated from an Arena, names are
+// interned symbol IDs and integer literals are already decoded, so consumers
+// never have to look at the CST wrapper chains or at token spellings.
+
+enum class ASTNodeKind : uint8_t {
+    FUNCTION,
+    PARAM,
+    RETURN,
+    BINARY_OP,
+    INT_LITERAL,
+    VAR_REF,
+};
+
+enum class BinaryOperator : uint8_t {
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+};
+
+// Script integers are 32-bit two's complement. Addition, subtraction and
+// multiplication wrap on overflow, x / 0 is 0, and INT32_MIN / -1 wraps to
+// INT32_MIN. Every evaluator must produce exactly these results.
+inline int32_t scriptDivide(int32_t lhs, int32_t rhs) {
+    if (rhs == 0) {
+        return 0;
+    }
+    if (rhs == -1) {
+        return (int32_t)(0u - (uint32_t)lhs);
+    }
+    return lhs / rhs;
+}
+
+inline int32_t applyBinaryOperator(BinaryOperator op, int32_t lhs, int32_t rhs) {
+    switch (op) {
+        case BinaryOperator::ADD:
+            return (int32_t)((uint32_t)lhs + (uint32_t)rhs);
+        case BinaryOperator::SUBTRACT:
+            return (int32_t)((uint32_t)lhs - (uint32_t)rhs);
+        case BinaryOperator::MULTIPLY:
+            return (int32_t)((uint32_t)lhs * (uint32_t)rhs);
+        default:
+            return scriptDivide(lhs, rhs);
+    }
+}
+
+struct ASTNode {
+    ASTNodeKind kind;
+};
+
+struct ASTExpression : ASTNode {};
+
+struct ASTIntLiteral : ASTExpression {
+    int32_t value;
+};
+
+struct ASTVarRef : ASTExpression {
+    uint32_t name;  // Interned symbol ID
+    uint32_t paramIndex;  // Position of the referenced parameter in its function
+};
+
+struct ASTBinaryOp : ASTExpression {
+    BinaryOperator op;
+    ASTExpression *lhs;
+    ASTExpression *rhs;
+};
+
+struct ASTReturn : ASTNode {
+    ASTExpression *value;
+};
+
+struct ASTParam : ASTNode {
+    uint32_t name;
+};
+
+struct ASTFunction : ASTNode {
+    uint32_t name;
+    std::span<ASTParam> params;
+    std::span<ASTReturn *> statements;
+};
+
+struct ASTProgram {
+    std::span<ASTFunction *> functions;
+};
+
+std::string binaryOperatorToString(BinaryOperator op);
+
+// Lowers a CST produced by parse() in a single non-recursive pass. Throws
+// runtime_error for programs that parse but are not meaningful, such as a
+// reference to an undeclared name.
+ASTProgram *lowerToAST(CSTNode *root, Arena &arena, const SymbolTable &symbols);
+
+void printAST(const ASTProgram *program, const SymbolTable &symbols);
+
+#endif // AST_H
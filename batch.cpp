@@ -0,0 +1,199 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCRIPT_BATCH_X86 1
+#include <immintrin.h>
+#else
+#define SCRIPT_BATCH_X86 0
+#endif
+
+using namespace std;
+
+const char *batchISAToString(BatchISA isa) {
+    switch (isa) {
+        case BatchISA::SCALAR:
+            return "scalar";
+        case BatchISA::AVX2:
+            return "AVX2";
+        case BatchISA::AVX512:
+            return "AVX-512";
+        default:
+            return "unknown";
+    }
+}
+
+// dst[i] = a[i] op b[i] for i in [start, n), one row at a time. Also used for
+// the tails the vector loops leave behind.
+static void runScalar(uint8_t opcode, int32_t *dst, const int32_t *a, const int32_t *b, size_t start, size_t n) {
+    BinaryOperator op = (BinaryOperator)(opcode - OP_ADD);
+    for (size_t i = start; i < n; ++i) {
+        dst[i] = applyBinaryOperator(op, a[i], b[i]);
+    }
+}
+
+#if SCRIPT_BATCH_X86
+
+// Integer division has no SIMD instruction, but both operands convert to
+// double exactly and truncating the correctly rounded quotient of two int32
+// values always yields the exact integer quotient. Lanes dividing by 0 or -1
+// are patched afterwards to match scriptDivide().
+__attribute__((target("avx2"))) static __m256i divideAVX2(__m256i a, __m256i b) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i divisorIsZero = _mm256_cmpeq_epi32(b, zero);
+    __m256i divisorIsMinusOne = _mm256_cmpeq_epi32(b, _mm256_set1_epi32(-1));
+    __m256i safeB = _mm256_blendv_epi8(b, _mm256_set1_epi32(1), divisorIsZero);
+
+    __m128i low = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+                                                    _mm256_cvtepi32_pd(_mm256_castsi256_si128(safeB))));
+    __m128i high = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+                                                     _mm256_cvtepi32_pd(_mm256_extracti128_si256(safeB, 1))));
+    __m256i quotient = _mm256_set_m128i(high, low);
+
+    quotient = _mm256_blendv_epi8(quotient, _mm256_sub_epi32(zero, a), divisorIsMinusOne);
+    return _mm256_andnot_si256(divisorIsZero, quotient);
+}
+
+__attribute__((target("avx2"))) static void runAVX2(uint8_t opcode, int32_t *dst, const int32_t *a, const int32_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i result;
+        switch (opcode) {
+            case OP_ADD:
+                result = _mm256_add_epi32(va, vb);
+                break;
+            case OP_SUBTRACT:
+                result = _mm256_sub_epi32(va, vb);
+                break;
+            case OP_MULTIPLY:
+                result = _mm256_mullo_epi32(va, vb);
+                break;
+            default:
+                result = divideAVX2(va, vb);
+                break;
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), result);
+    }
+    runScalar(opcode, dst, a, b, i, n);
+}
+
+__attribute__((target("avx512f"))) static __m512i divideAVX512(__m512i a, __m512i b) {
+    __mmask16 divisorIsZero = _mm512_cmpeq_epi32_mask(b, _mm512_setzero_si512());
+    __mmask16 divisorIsMinusOne = _mm512_cmpeq_epi32_mask(b, _mm512_set1_epi32(-1));
+    __m512i safeB = _mm512_mask_mov_epi32(b, divisorIsZero, _mm512_set1_epi32(1));
+
+    __m256i low = _mm512_cvttpd_epi32(_mm512_div_pd(_mm512_cvtepi32_pd(_mm512_castsi512_si256(a)),
+                                                    _mm512_cvtepi32_pd(_mm512_castsi512_si256(safeB))));
+    __m256i high = _mm512_cvttpd_epi32(_mm512_div_pd(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(a, 1)),
+                                                     _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(safeB, 1))));
+    __m512i quotient = _mm512_inserti64x4(_mm512_castsi256_si512(low), high, 1);
+
+    quotient = _mm512_mask_sub_epi32(quotient, divisorIsMinusOne, _mm512_setzero_si512(), a);
+    return _mm512_maskz_mov_epi32(~divisorIsZero, quotient);
+}
+
+__attribute__((target("avx512f"))) static void runAVX512(uint8_t opcode, int32_t *dst, const int32_t *a, const int32_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i va = _mm512_loadu_si512(a + i);
+        __m512i vb = _mm512_loadu_si512(b + i);
+        __m512i result;
+        switch (opcode) {
+            case OP_ADD:
+                result = _mm512_add_epi32(va, vb);
+                break;
+            case OP_SUBTRACT:
+                result = _mm512_sub_epi32(va, vb);
+                break;
+            case OP_MULTIPLY:
+                result = _mm512_mullo_epi32(va, vb);
+                break;
+            default:
+                result = divideAVX512(va, vb);
+                break;
+        }
+        _mm512_storeu_si512(dst + i, result);
+    }
+    runScalar(opcode, dst, a, b, i, n);
+}
+
+#endif
+
+BatchISA BatchKernel::detectISA() {
+#if SCRIPT_BATCH_X86
+    if (__builtin_cpu_supports("avx512f")) {
+        return BatchISA::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return BatchISA::AVX2;
+    }
+#endif
+    return BatchISA::SCALAR;
+}
+
+BatchKernel::BatchKernel(const BytecodeFunction &function) : BatchKernel(function, detectISA()) {}
+
+BatchKernel::BatchKernel(const BytecodeFunction &function, BatchISA isa) : function(function), selectedISA(isa) {
+    if (isa != BatchISA::SCALAR && detectISA() < isa) {
+        throw runtime_error(string("CPU does not support ") + batchISAToString(isa));
+    }
+    // Constant registers are filled once; they are never written by the code
+    scratch.resize((function.registerCount - function.paramCount) * BLOCK_ROWS);
+    for (size_t i = 0; i < function.constants.size(); ++i) {
+        fill_n(scratch.begin() + i * BLOCK_ROWS, BLOCK_ROWS, function.constants[i]);
+    }
+}
+
+void BatchKernel::evaluate(const span<const int32_t> columns[], span<int32_t> out) {
+    size_t rows = out.size();
+    for (uint32_t i = 0; i < function.paramCount; ++i) {
+        if (columns[i].size() != rows) {
+            throw runtime_error("Column " + to_string(i) + " has " + to_string(columns[i].size()) +
+                                " rows, expected " + to_string(rows));
+        }
+    }
+
+    vector<int32_t *> registers(function.registerCount);
+    for (uint32_t reg = function.paramCount; reg < function.registerCount; ++reg) {
+        registers[reg] = scratch.data() + (reg - function.paramCount) * BLOCK_ROWS;
+    }
+
+    for (size_t start = 0; start < rows; start += BLOCK_ROWS) {
+        size_t n = min(BLOCK_ROWS, rows - start);
+        for (uint32_t reg = 0; reg < function.paramCount; ++reg) {
+            registers[reg] = const_cast<int32_t *>(columns[reg].data()) + start;  // Parameters are only ever read
+        }
+
+        for (const Instruction &instruction : function.code) {
+            if (instruction.opcode == OP_RETURN) {
+                copy_n(registers[instruction.a], n, out.begin() + start);
+                break;
+            }
+            int32_t *dst = registers[instruction.dst];
+            const int32_t *a = registers[instruction.a];
+            const int32_t *b = registers[instruction.b];
+            switch (selectedISA) {
+#if SCRIPT_BATCH_X86
+                case BatchISA::AVX512:
+                    runAVX512(instruction.opcode, dst, a, b, n);
+                    break;
+                case BatchISA::AVX2:
+                    runAVX2(instruction.opcode, dst, a, b, n);
+                    break;
+#endif
+                default:
+                    runScalar(instruction.opcode, dst, a, b, 0, n);
+                    break;
+            }
+        }
+    }
+}
+
+void evaluateBatch(const BytecodeFunction &function, const span<const int32_t> columns[], span<int32_t> out) {
+    BatchKernel(function).evaluate(columns, out);
+}
@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bytecode.h"
+
+enum class BatchISA {
+    SCALAR,
+    AVX2,  // 8 lanes
+    AVX512,  // 16 lanes
+};
+
+const char *batchISAToString(BatchISA isa);
+
+// Evaluates one script function over columns of arguments. The bytecode is
+// run one instruction at a time over blocks of rows, so every instruction
+// becomes a tight SIMD loop over whole columns instead of a dispatch per row.
+// Results are bit-for-bit those of the VM, including x / 0 and
+// INT32_MIN / -1.
+class BatchKernel {
+public:
+    // Picks the widest instruction set the CPU supports
+    explicit BatchKernel(const BytecodeFunction &function);
+    BatchKernel(const BytecodeFunction &function, BatchISA isa);
+
+    // columns[i] holds argument i for every row and must be as long as out.
+    // Throws runtime_error on a length mismatch.
+    void evaluate(const std::span<const int32_t> columns[], std::span<int32_t> out);
+
+    BatchISA isa() const { return selectedISA; }
+
+    // Widest instruction set usable on this CPU
+    static BatchISA detectISA();
+
+private:
+    static constexpr size_t BLOCK_ROWS = 512;
+
+    const BytecodeFunction &function;
+    BatchISA selectedISA;
+    std::vector<int32_t> scratch;  // One BLOCK_ROWS column per non-parameter register
+};
+
+// Convenience wrapper that builds a BatchKernel for a single call
+void evaluateBatch(const BytecodeFunction &function, const std::span<const int32_t> columns[], std::span<int32_t> out);
+
+#endif // BATCH_H
@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ast.h"
+#include "batch.h"
+#include "bytecode.h"
+#include "cst_writer.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "script_parser.h"
+
+using namespace std;
+
+// Reference evaluator that walks the CST directly, resolving names by string
+// comparison on every visit. It is what a consumer without the AST or the VM
+// would write, and serves as the baseline for the benchmarks below.
+class CSTEvaluator {
+public:
+    CSTEvaluator(CSTNode *function) : function(function) {
+        collectParams(function);
+    }
+
+    int32_t call(const vector<int32_t> &args) {
+        this->args = &args;
+        for (CSTNode *child : function->children) {
+            if (child->type == CSTNodeType::STATEMENT_LIST) {
+                CSTNode *statementList = child;
+                while (statementList->children.size() == 2) {
+                    statementList = statementList->children[0];
+                }
+                return evaluate(statementList->children[0]->children[1]);
+            }
+        }
+        return 0;
+    }
+
+private:
+    void collectParams(CSTNode *node) {
+        if (node->type == CSTNodeType::PARAMETER) {
+            params.push_back(dynamic_cast<CSTTerminalNode *>(node->children[1])->value);
+            return;
+        }
+        if (node->type == CSTNodeType::STATEMENT_LIST) {
+            return;
+        }
+        for (CSTNode *child : node->children) {
+            collectParams(child);
+        }
+    }
+
+    int32_t evaluate(CSTNode *node) {
+        if (node->children.size() == 3) {
+            if (node->type == CSTNodeType::FACTOR) {
+                return evaluate(node->children[1]);
+            }
+            auto *middle = dynamic_cast<CSTTerminalNode *>(node->children[1]);
+            int32_t lhs = evaluate(node->children[0]);
+            int32_t rhs = evaluate(node->children[2]);
+            switch (middle->type) {
+                case CSTTerminalNodeType::PLUS:
+                    return applyBinaryOperator(BinaryOperator::ADD, lhs, rhs);
+                case CSTTerminalNodeType::MINUS:
+                    return applyBinaryOperator(BinaryOperator::SUBTRACT, lhs, rhs);
+                case CSTTerminalNodeType::ASTERISK:
+                    return applyBinaryOperator(BinaryOperator::MULTIPLY, lhs, rhs);
+                default:
+                    return applyBinaryOperator(BinaryOperator::DIVIDE, lhs, rhs);
+            }
+        }
+        if (node->type != CSTNodeType::TERMINAL) {
+            return evaluate(node->children[0]);
+        }
+        auto *terminal = dynamic_cast<CSTTerminalNode *>(node);
+        if (terminal->type == CSTTerminalNodeType::NUMBER) {
+            return (int32_t)terminal->integer;
+        }
+        for (size_t i = 0; i < params.size(); ++i) {
+            if (params[i] == terminal->value) {
+                return (*args)[i];
+            }
+        }
+        throw runtime_error("Undeclared name: " + string(terminal->value));
+    }
+
+    CSTNode *function;
+    vector<string_view> params;
+    const vector<int32_t> *args = nullptr;
+};
+
+static CSTNode *findCSTFunction(CSTNode *node, string_view name) {
+    if (node->type == CSTNodeType::FUNCTION) {
+        return dynamic_cast<CSTTerminalNode *>(node->children[1])->value == name ? node : nullptr;
+    }
+    for (CSTNode *child : node->children) {
+        if (CSTNode *found = findCSTFunction(child, name)) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+template <typename Call>
+static void report(const string &label, long iterations, Call call) {
+    int64_t checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        checksum += call((int32_t)i);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << label << ": " << (long)(iterations / elapsed.count()) << " calls/s"
+         << " (checksum " << checksum << ")" << endl;
+}
+
+// benchmark call: evaluates one function repeatedly, varying its first
+// argument on every iteration, with each available evaluator.
+static int benchmarkCall(int argc, char *argv[]) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " call <input_file> <function> [args...]" << endl;
+        return 1;
+    }
+    string functionName = argv[3];
+    vector<int32_t> args;
+    for (int i = 4; i < argc; ++i) {
+        args.push_back(atoi(argv[i]));
+    }
+    long iterations = 10000000;
+    if (const char *env = getenv("BENCHMARK_ITERATIONS")) {
+        iterations = atol(env);
+    }
+
+    SymbolTable symbols;
+    CSTNode *cstRoot = parse(tokenize(readFile(argv[2]), symbols, false), false);
+    CSTNode *cstFunction = findCSTFunction(cstRoot, functionName);
+    if (cstFunction == nullptr) {
+        throw runtime_error("Unknown function: " + functionName);
+    }
+
+    Arena astArena;
+    ASTProgram *astRoot = lowerToAST(cstRoot, astArena, symbols);
+    BytecodeProgram program = compileProgram(astRoot, symbols);
+    VM vm(program);
+    int functionIndex = program.findFunction(functionName);
+    vector<int32_t> callArgs = args;
+    if (vm.call(functionIndex, callArgs) != CSTEvaluator(cstFunction).call(callArgs)) {
+        throw runtime_error("Evaluators disagree on " + functionName);
+    }
+
+    CSTEvaluator cstEvaluator(cstFunction);
+    report("CST walk", iterations / 10, [&](int32_t i) {
+        if (!callArgs.empty()) callArgs[0] = args[0] + i;
+        return cstEvaluator.call(callArgs);
+    });
+    report("Bytecode VM", iterations, [&](int32_t i) {
+        if (!callArgs.empty()) callArgs[0] = args[0] + i;
+        return vm.call(functionIndex, callArgs);
+    });
+
+    OptimizationStats optimizationStats;
+    optimizeProgram(astRoot, astArena, optimizationStats);
+    BytecodeProgram optimizedProgram = compileProgram(astRoot, symbols);
+    VM optimizedVM(optimizedProgram);
+    if (optimizedVM.call(functionIndex, args) != vm.call(functionIndex, args)) {
+        throw runtime_error("Optimized program disagrees on " + functionName);
+    }
+    report("Bytecode VM (optimized)", iterations, [&](int32_t i) {
+        if (!callArgs.empty()) callArgs[0] = args[0] + i;
+        return optimizedVM.call(functionIndex, callArgs);
+    });
+
+    TieredExecutor executor(optimizedProgram);
+    for (uint32_t i = 0; i <= TieredExecutor::DEFAULT_JIT_THRESHOLD; ++i) {
+        if (executor.call(functionIndex, args) != vm.call(functionIndex, args)) {
+            throw runtime_error("Tiered executor disagrees on " + functionName);
+        }
+    }
+    string tieredLabel = executor.isCompiled(functionIndex) ? "Tiered (x86-64 JIT)" : "Tiered (JIT unavailable)";
+    report(tieredLabel, iterations, [&](int32_t i) {
+        if (!callArgs.empty()) callArgs[0] = args[0] + i;
+        return executor.call(functionIndex, callArgs);
+    });
+    return 0;
+}
+
+// benchmark batch: evaluates one function over columns of random arguments,
+// row by row in the VM and with every batch kernel the CPU supports.
+static int benchmarkBatch(int argc, char *argv[]) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " batch <input_file> <function> [rows]" << endl;
+        return 1;
+    }
+    string functionName = argv[3];
+    size_t rows = argc > 4 ? atol(argv[4]) : 10000000;
+
+    SymbolTable symbols;
+    CSTNode *cstRoot = parse(tokenize(readFile(argv[2]), symbols, false), false);
+    Arena astArena;
+    ASTProgram *astRoot = lowerToAST(cstRoot, astArena, symbols);
+    OptimizationStats optimizationStats;
+    optimizeProgram(astRoot, astArena, optimizationStats);
+    BytecodeProgram program = compileProgram(astRoot, symbols);
+    int functionIndex = program.findFunction(functionName);
+    if (functionIndex < 0) {
+        throw runtime_error("Unknown function: " + functionName);
+    }
+    const BytecodeFunction &function = program.functions[functionIndex];
+
+    // Mostly small values, with the division edge cases mixed in
+    mt19937 random(42);
+    uniform_int_distribution<int32_t> small(-1000, 1000);
+    vector<vector<int32_t>> columnData(function.paramCount, vector<int32_t>(rows));
+    vector<span<const int32_t>> columns;
+    for (auto &column : columnData) {
+        for (size_t i = 0; i < rows; ++i) {
+            column[i] = i % 97 == 0 ? INT32_MIN : small(random);
+        }
+        columns.push_back(column);
+    }
+
+    auto time = [&](const string &label, auto evaluate) {
+        auto start = chrono::steady_clock::now();
+        evaluate();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        cout << label << ": " << (long)(rows / elapsed.count()) << " rows/s" << endl;
+    };
+
+    vector<int32_t> expected(rows);
+    VM vm(program);
+    time("Bytecode VM, one call per row", [&] {
+        vector<int32_t> args(function.paramCount);
+        for (size_t i = 0; i < rows; ++i) {
+            for (uint32_t p = 0; p < function.paramCount; ++p) {
+                args[p] = columnData[p][i];
+            }
+            expected[i] = vm.call(functionIndex, args);
+        }
+    });
+
+    for (BatchISA isa : {BatchISA::SCALAR, BatchISA::AVX2, BatchISA::AVX512}) {
+        if (isa != BatchISA::SCALAR && BatchKernel::detectISA() < isa) {
+            continue;
+        }
+        BatchKernel kernel(function, isa);
+        vector<int32_t> out(rows);
+        time(string("Batch kernel (") + batchISAToString(isa) + ")", [&] { kernel.evaluate(columns.data(), out); });
+        if (out != expected) {
+            throw runtime_error(string("Batch kernel (") + batchISAToString(isa) + ") disagrees with the VM");
+        }
+    }
+    return 0;
+}
+
+// benchmark parse: lexes and parses the input repeated many times over,
+// timing each phase separately.
+static int benchmarkParse(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " parse <input_file> [copies]" << endl;
+        return 1;
+    }
+    long copies = argc > 3 ? atol(argv[3]) : 10000;
+    string source = readFile(argv[2]);
+    string input;
+    for (long i = 0; i < copies; ++i) {
+        input += source;
+        input += '\n';
+    }
+
+    SymbolTable symbols;
+    auto start = chrono::steady_clock::now();
+    vector<CSTNode *> tokens = tokenize(input, symbols, false);
+    chrono::duration<double> lexTime = chrono::steady_clock::now() - start;
+    cout << "Lexing: " << (long)(tokens.size() / lexTime.count()) << " tokens/s" << endl;
+
+    size_t threadCount = max(thread::hardware_concurrency(), 1u);
+    SymbolTable parallelSymbols;
+    start = chrono::steady_clock::now();
+    vector<CSTNode *> parallelTokens = tokenizeParallel(input, parallelSymbols, threadCount);
+    chrono::duration<double> parallelLexTime = chrono::steady_clock::now() - start;
+    cout << "Lexing on " << threadCount << " threads: " << (long)(parallelTokens.size() / parallelLexTime.count())
+         << " tokens/s" << endl;
+
+    start = chrono::steady_clock::now();
+    CSTNode *cstRoot = parse(tokens, false);
+    chrono::duration<double> parseTime = chrono::steady_clock::now() - start;
+    cout << "Parsing: " << (long)(tokens.size() / parseTime.count()) << " tokens/s"
+         << " (" << cstRoot->children.size() << " root children)" << endl;
+
+    // Lexer and parser on two threads, overlapped
+    SymbolTable pipelineSymbols;
+    vector<CSTNode *> pipelineTokens;
+    start = chrono::steady_clock::now();
+    parsePipelined(input, pipelineSymbols, pipelineTokens);
+    chrono::duration<double> pipelineTime = chrono::steady_clock::now() - start;
+    cout << "Lexing and parsing pipelined on two threads: " << (long)(pipelineTokens.size() / pipelineTime.count())
+         << " tokens/s" << endl;
+
+    // Source pushed in socket-sized chunks, lexing included
+    SymbolTable pushSymbols;
+    ScriptPushParser pushParser(pushSymbols);
+    start = chrono::steady_clock::now();
+    for (size_t offset = 0; offset < input.size(); offset += 4096) {
+        pushParser.feed(string_view(input).substr(offset, 4096));
+    }
+    pushParser.finish();
+    chrono::duration<double> pushTime = chrono::steady_clock::now() - start;
+    cout << "Lexing and parsing pushed in 4 KiB chunks: " << (long)(pushParser.tokens().size() / pushTime.count())
+         << " tokens/s" << endl;
+
+    // Many parses in flight on one thread, each fed a small chunk in turn
+    const size_t streamCount = 1024;
+    string stream;
+    for (long i = 0; i < max(copies / (long)streamCount, 1L); ++i) {
+        stream += source;
+        stream += '\n';
+    }
+    vector<unique_ptr<ScriptPushParser>> streams;
+    for (size_t i = 0; i < streamCount; ++i) {
+        streams.push_back(make_unique<ScriptPushParser>(pushSymbols));
+    }
+    size_t streamTokens = 0;
+    start = chrono::steady_clock::now();
+    for (size_t offset = 0; offset < stream.size(); offset += 256) {
+        for (auto &parser : streams) {
+            parser->feed(string_view(stream).substr(offset, 256));
+        }
+    }
+    for (auto &parser : streams) {
+        parser->finish();
+        streamTokens += parser->tokens().size();
+    }
+    chrono::duration<double> streamTime = chrono::steady_clock::now() - start;
+    cout << "Lexing and parsing " << streamCount << " interleaved streams in 256 byte chunks: "
+         << (long)(streamTokens / streamTime.count()) << " tokens/s" << endl;
+
+    // The same tokens through the GLR driver, which never forks on this grammar
+    Arena forestArena;
+    start = chrono::steady_clock::now();
+    SPPFNode *forestRoot = parseForest(tokens, forestArena);
+    chrono::duration<double> forestTime = chrono::steady_clock::now() - start;
+    cout << "Parsing into a forest (GLR): " << (long)(tokens.size() / forestTime.count()) << " tokens/s"
+         << " (" << forestRoot->end << " tokens)" << endl;
+
+    start = chrono::steady_clock::now();
+    validate(input);
+    chrono::duration<double> validateTime = chrono::steady_clock::now() - start;
+    cout << "Lexing and validating, no tree: " << (long)(tokens.size() / validateTime.count()) << " tokens/s" << endl;
+
+    // Collects function names and parameter counts from callbacks alone
+    struct Fact {
+        string_view name;
+        int count;
+    };
+    vector<pair<string_view, int>> signatures;
+    start = chrono::steady_clock::now();
+    parseWithCallbacks<Fact>(
+        input, [](const ScriptToken &token) { return Fact{token.text, 0}; },
+        [&](int rule, span<Fact> rhs) {
+            switch (ParserTables::ruleLhs[rule]) {
+                case CSTNodeType::PARAMETER_LIST:
+                    return Fact{{}, rhs.size() == 1 ? 1 : rhs[0].count + 1};
+                case CSTNodeType::FUNCTION:
+                    signatures.push_back({rhs[1].name, rhs.size() == 8 ? rhs[3].count : 0});
+                    return Fact{};
+                default:
+                    return Fact{};
+            }
+        });
+    chrono::duration<double> callbackTime = chrono::steady_clock::now() - start;
+    cout << "Lexing and collecting signatures with callbacks: " << (long)(tokens.size() / callbackTime.count())
+         << " tokens/s (" << signatures.size() << " functions)" << endl;
+
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr) {
+        throw runtime_error("Failed to open /dev/null");
+    }
+    // The indented tree format is left out: left-recursive lists nest one
+    // level per element, so its indentation grows quadratically here
+    for (const char *formatName : {"sexpr", "jsonl"}) {
+        CSTWriter writer(devNull);
+        start = chrono::steady_clock::now();
+        writer.write(cstRoot, parseCSTFormat(formatName));
+        writer.flush();
+        chrono::duration<double> writeTime = chrono::steady_clock::now() - start;
+        cout << "Writing the CST (" << formatName << "): " << (long)(tokens.size() / writeTime.count()) << " tokens/s" << endl;
+    }
+    fclose(devNull);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <benchmark> [args...]" << endl;
+        cerr << "Benchmarks: call, batch, parse" << endl;
+        return 1;
+    }
+
+    try {
+        string benchmark = argv[1];
+        if (benchmark == "call") {
+            return benchmarkCall(argc, argv);
+        }
+        if (benchmark == "batch") {
+            return benchmarkBatch(argc, argv);
+        }
+        if (benchmark == "parse") {
+            return benchmarkParse(argc, argv);
+        }
+        cerr << "Unknown benchmark: " << benchmark << endl;
+        return 1;
+    } catch (const runtime_error &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,313 @@
+#include "bytecode.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int BytecodeProgram::findFunction(string_view name) const {
+    uint32_t symbol = symbols->lookup(name);
+    if (symbol == SymbolTable::INVALID_SYMBOL) {
+        return -1;
+    }
+    auto iter = functionBySymbol.find(symbol);
+    return iter == functionBySymbol.end() ? -1 : (int)iter->second;
+}
+
+namespace {
+
+class FunctionCompiler {
+public:
+    FunctionCompiler(const ASTFunction *function, const SymbolTable &symbols) : function(function), symbols(symbols) {}
+
+    // Appends the function's code and constants to the program's pools. The
+    // spans of the returned function are left empty because the pools may
+    // still move while later functions compile.
+    BytecodeFunction compile(vector<Instruction> &instructionPool, vector<int32_t> &constantPool) {
+        BytecodeFunction result;
+        result.name = function->name;
+        result.paramCount = function->params.size();
+
+        // Constants are numbered first so temporaries can start right after them
+        vector<unordered_map<const ASTExpression *, uint32_t>> useCounts;
+        for (const ASTReturn *statement : function->statements) {
+            useCounts.push_back(analyze(statement->value));
+        }
+        uint32_t sharedBase = result.paramCount + constants.size();
+        registerCount = sharedBase;
+        checkRegister(registerCount == 0 ? 0 : registerCount - 1);
+
+        for (size_t i = 0; i < function->statements.size(); ++i) {
+            // Nodes used more than once (after value numbering) each keep a
+            // register of their own for the whole statement; everything else
+            // lives in stack-allocated temporaries above them
+            uint32_t sharedCount = 0;
+            for (const auto &[node, uses] : useCounts[i]) {
+                if (uses > 1) {
+                    sharedCount++;
+                }
+            }
+            sharedUses = &useCounts[i];
+            sharedRegisters.clear();
+            nextShared = sharedBase;
+            nextTemporary = sharedBase + sharedCount;
+            registerCount = max(registerCount, nextTemporary);
+
+            uint32_t value = compileExpression(function->statements[i]->value);
+            code.push_back({OP_RETURN, 0, (uint8_t)value, 0});
+        }
+
+        result.registerCount = registerCount;
+        constantPool.insert(constantPool.end(), constants.begin(), constants.end());
+        instructionPool.insert(instructionPool.end(), code.begin(), code.end());
+        return result;
+    }
+
+private:
+    void checkRegister(uint32_t reg) {
+        if (reg >= MAX_REGISTERS) {
+            throw runtime_error("Function needs more than " + to_string(MAX_REGISTERS) +
+                                " registers: " + string(symbols.name(function->name)));
+        }
+    }
+
+    // Assigns registers to the constants of expression and counts how often
+    // each BinaryOp is referenced, which is more than once only for nodes the
+    // optimizer has value-numbered together
+    unordered_map<const ASTExpression *, uint32_t> analyze(const ASTExpression *expression) {
+        unordered_map<const ASTExpression *, uint32_t> uses;
+        vector<const ASTExpression *> pending = {expression};
+        while (!pending.empty()) {
+            const ASTExpression *current = pending.back();
+            pending.pop_back();
+            if (current->kind == ASTNodeKind::INT_LITERAL) {
+                int32_t value = static_cast<const ASTIntLiteral *>(current)->value;
+                if (constantRegisters.find(value) == constantRegisters.end()) {
+                    constantRegisters[value] = function->params.size() + constants.size();
+                    constants.push_back(value);
+                }
+            } else if (current->kind == ASTNodeKind::BINARY_OP) {
+                if (uses[current]++ > 0) {
+                    continue;
+                }
+                auto *binaryOp = static_cast<const ASTBinaryOp *>(current);
+                pending.push_back(binaryOp->rhs);
+                pending.push_back(binaryOp->lhs);
+            }
+        }
+        return uses;
+    }
+
+    // Returns the register holding the value of expression. Temporaries are
+    // handed out like a stack, so a BinaryOp reuses its operands' registers.
+    // The walk is post-order with an explicit stack, since an expression
+    // nests one level per operator and a long one would overflow the call
+    // stack. A BinaryOp's frame is visited twice: once to note the first free
+    // temporary and queue its operands, lhs on top so it is compiled first,
+    // and once more, when their registers are on top of values, to emit it.
+    uint32_t compileExpression(const ASTExpression *root) {
+        struct Frame {
+            const ASTExpression *expression;
+            uint32_t mark;  // nextTemporary before the operands, once expanded
+            bool expanded;
+        };
+        vector<Frame> pending = {{root, 0, false}};
+        vector<uint32_t> values;
+        while (!pending.empty()) {
+            Frame frame = pending.back();
+            const ASTExpression *expression = frame.expression;
+            if (expression->kind == ASTNodeKind::VAR_REF) {
+                pending.pop_back();
+                values.push_back(static_cast<const ASTVarRef *>(expression)->paramIndex);
+                continue;
+            }
+            if (expression->kind == ASTNodeKind::INT_LITERAL) {
+                pending.pop_back();
+                values.push_back(constantRegisters.at(static_cast<const ASTIntLiteral *>(expression)->value));
+                continue;
+            }
+
+            auto *binaryOp = static_cast<const ASTBinaryOp *>(expression);
+            if (!frame.expanded) {
+                auto shared = sharedRegisters.find(expression);
+                if (shared != sharedRegisters.end()) {
+                    pending.pop_back();
+                    values.push_back(shared->second);
+                    continue;
+                }
+                pending.back() = {expression, nextTemporary, true};
+                pending.push_back({binaryOp->rhs, 0, false});
+                pending.push_back({binaryOp->lhs, 0, false});
+                continue;
+            }
+
+            pending.pop_back();
+            uint32_t rhs = values.back();
+            values.pop_back();
+            uint32_t lhs = values.back();
+            values.pop_back();
+            nextTemporary = frame.mark;
+            uint32_t dst;
+            if (sharedUses->at(expression) > 1) {
+                dst = nextShared++;
+                sharedRegisters[expression] = dst;
+            } else {
+                dst = nextTemporary++;
+            }
+            checkRegister(dst);
+            registerCount = max(registerCount, nextTemporary);
+            uint8_t opcode = OP_ADD + (uint8_t)binaryOp->op;
+            code.push_back({opcode, (uint8_t)dst, (uint8_t)lhs, (uint8_t)rhs});
+            values.push_back(dst);
+        }
+        return values.back();
+    }
+
+    const ASTFunction *function;
+    const SymbolTable &symbols;
+    unordered_map<int32_t, uint32_t> constantRegisters;
+    vector<int32_t> constants;
+    vector<Instruction> code;
+    const unordered_map<const ASTExpression *, uint32_t> *sharedUses = nullptr;
+    unordered_map<const ASTExpression *, uint32_t> sharedRegisters;
+    uint32_t nextShared = 0;
+    uint32_t nextTemporary = 0;
+    uint32_t registerCount = 0;
+};
+
+}  // namespace
+
+BytecodeProgram compileProgram(const ASTProgram *program, const SymbolTable &symbols) {
+    BytecodeProgram result;
+    result.symbols = &symbols;
+    // Start offsets of each function's code and constants, plus one past the end
+    vector<size_t> codeStarts = {0};
+    vector<size_t> constantStarts = {0};
+    for (const ASTFunction *function : program->functions) {
+        result.functionBySymbol[function->name] = result.functions.size();
+        result.functions.push_back(FunctionCompiler(function, symbols).compile(result.instructionPool, result.constantPool));
+        codeStarts.push_back(result.instructionPool.size());
+        constantStarts.push_back(result.constantPool.size());
+    }
+    span<const Instruction> instructions(result.instructionPool);
+    span<const int32_t> constants(result.constantPool);
+    for (size_t i = 0; i < result.functions.size(); ++i) {
+        result.functions[i].code = instructions.subspan(codeStarts[i], codeStarts[i + 1] - codeStarts[i]);
+        result.functions[i].constants = constants.subspan(constantStarts[i], constantStarts[i + 1] - constantStarts[i]);
+    }
+    return result;
+}
+
+static const char *opcodeToString(uint8_t opcode) {
+    switch (opcode) {
+        case OP_ADD:
+            return "ADD";
+        case OP_SUBTRACT:
+            return "SUB";
+        case OP_MULTIPLY:
+            return "MUL";
+        case OP_DIVIDE:
+            return "DIV";
+        case OP_RETURN:
+            return "RET";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+void printBytecode(const BytecodeProgram &program) {
+    for (const BytecodeFunction &function : program.functions) {
+        cout << program.symbols->name(function.name) << ": " << function.paramCount << " params, "
+             << function.registerCount << " registers\n";
+        for (size_t i = 0; i < function.constants.size(); ++i) {
+            cout << "  r" << function.paramCount + i << " = " << function.constants[i] << "\n";
+        }
+        for (const Instruction &instruction : function.code) {
+            cout << "  " << opcodeToString(instruction.opcode);
+            if (instruction.opcode == OP_RETURN) {
+                cout << " r" << (int)instruction.a << "\n";
+            } else {
+                cout << " r" << (int)instruction.dst << ", r" << (int)instruction.a << ", r" << (int)instruction.b << "\n";
+            }
+        }
+    }
+    cout.flush();
+}
+
+VM::VM(const BytecodeProgram &program) : program(program) {
+    uint32_t registerCount = 0;
+    for (const BytecodeFunction &function : program.functions) {
+        registerCount = max(registerCount, function.registerCount);
+    }
+    registers.resize(registerCount);
+}
+
+int32_t VM::call(string_view name, span<const int32_t> args) {
+    int functionIndex = program.findFunction(name);
+    if (functionIndex < 0) {
+        throw runtime_error("Unknown function: " + string(name));
+    }
+    return call((uint32_t)functionIndex, args);
+}
+
+int32_t VM::call(uint32_t functionIndex, span<const int32_t> args) {
+    const BytecodeFunction &function = program.functions[functionIndex];
+    if (args.size() != function.paramCount) {
+        throw runtime_error("Function " + string(program.symbols->name(function.name)) + " expects " +
+                            to_string(function.paramCount) + " arguments, got " + to_string(args.size()));
+    }
+    copy(args.begin(), args.end(), registers.begin());
+    copy(function.constants.begin(), function.constants.end(), registers.begin() + function.paramCount);
+    return execute(function);
+}
+
+int32_t VM::execute(const BytecodeFunction &function) {
+    int32_t *r = registers.data();
+    const Instruction *ip = function.code.data();
+
+#if defined(__GNUC__)
+    // Computed-goto dispatch: each handler jumps straight to the next one
+    static const void *const dispatchTable[OPCODE_COUNT] = {
+        &&op_add, &&op_subtract, &&op_multiply, &&op_divide, &&op_return,
+    };
+#define DISPATCH() goto *dispatchTable[ip->opcode]
+
+    DISPATCH();
+op_add:
+    r[ip->dst] = (int32_t)((uint32_t)r[ip->a] + (uint32_t)r[ip->b]);
+    ++ip;
+    DISPATCH();
+op_subtract:
+    r[ip->dst] = (int32_t)((uint32_t)r[ip->a] - (uint32_t)r[ip->b]);
+    ++ip;
+    DISPATCH();
+op_multiply:
+    r[ip->dst] = (int32_t)((uint32_t)r[ip->a] * (uint32_t)r[ip->b]);
+    ++ip;
+    DISPATCH();
+op_divide:
+    r[ip->dst] = scriptDivide(r[ip->a], r[ip->b]);
+    ++ip;
+    DISPATCH();
+op_return:
+    return r[ip->a];
+
+#undef DISPATCH
+#else
+    while (true) {
+        switch (ip->opcode) {
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+                r[ip->dst] = applyBinaryOperator((BinaryOperator)(ip->opcode - OP_ADD), r[ip->a], r[ip->b]);
+                ++ip;
+                break;
+            case OP_RETURN:
+                return r[ip->a];
+        }
+    }
+#endif
+}
@@ -0,0 +1,90 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "symbol_table.h"
+
+// Register-based bytecode for script functions.
+//
+// Each function runs on its own register file laid out as
+//   [ parameters | constants | temporaries ]
+// so parameter and literal operands never need a load instruction: every
+// BinaryOp becomes exactly one instruction and a function body ends in RET.
+
+enum Opcode : uint8_t {
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_RETURN,
+    OPCODE_COUNT,
+};
+
+// Register operands are one byte, so no function has more registers
+static const uint32_t MAX_REGISTERS = 256;
+
+// Fixed-width instruction: r[dst] = r[a] <op> r[b], or return r[a]
+struct Instruction {
+    uint8_t opcode;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+};
+
+struct BytecodeFunction {
+    uint32_t name;  // Interned symbol ID
+    uint32_t paramCount;
+    uint32_t registerCount;
+    std::span<const int32_t> constants;  // Copied to r[paramCount...] on every call
+    std::span<const Instruction> code;
+};
+
+// Functions refer to their code and constants through spans, so a program can
+// either own that storage (when compiled here) or point into memory owned by
+// someone else, such as a mapped program image. Copying would leave the spans
+// pointing at the original, so programs can only be moved.
+struct BytecodeProgram {
+    std::vector<BytecodeFunction> functions;
+    std::unordered_map<uint32_t, uint32_t> functionBySymbol;  // Symbol ID -> index into functions
+    const SymbolTable *symbols;
+    std::vector<Instruction> instructionPool;  // Backing storage when compiled in-process
+    std::vector<int32_t> constantPool;
+
+    BytecodeProgram() = default;
+    BytecodeProgram(BytecodeProgram &&) = default;
+    BytecodeProgram &operator=(BytecodeProgram &&) = default;
+
+    // Returns the index of the named function, or -1 if there is none
+    int findFunction(std::string_view name) const;
+};
+
+// Throws runtime_error if a function needs more registers than an
+// instruction can address.
+BytecodeProgram compileProgram(const ASTProgram *program, const SymbolTable &symbols);
+
+void printBytecode(const BytecodeProgram &program);
+
+// Executes functions of a compiled program. A VM owns its register file and
+// may be reused for any number of calls, but not from several threads at once.
+class VM {
+public:
+    explicit VM(const BytecodeProgram &program);
+
+    // Throws runtime_error for an unknown function or a wrong argument count
+    int32_t call(std::string_view name, std::span<const int32_t> args);
+    int32_t call(uint32_t functionIndex, std::span<const int32_t> args);
+
+private:
+    int32_t execute(const BytecodeFunction &function);
+
+    const BytecodeProgram &program;
+    std::vector<int32_t> registers;
+};
+
+#endif // BYTECODE_H
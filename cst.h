@@ -1,8 +1,11 @@
 #ifndef CST_H
 #define CST_H
 
+#include <charconv>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 
 enum CSTNodeType {
     PROGRAM,
@@ -19,7 +22,7 @@ enum CSTNodeType {
     TERMINAL,
 };
 
-std::string cstNodeTypeToString(CSTNodeType type) {
+inline std::string cstNodeTypeToString(CSTNodeType type) {
     switch (type) {
         case PROGRAM:
             return "PROGRAM";
@@ -57,18 +60,11 @@ public:
     std::vector<CSTNode *> children;
     CSTNode() {}
     CSTNode(CSTNodeType type) : type(type) {}
+    virtual ~CSTNode() = default;
     void addChild(CSTNode *child) {
         child->parent = this;
         children.push_back(child);
     }
-
-    virtual void print(int level = 0) const {
-        for (int i = 0; i < level; ++i) std::cout << "  ";  // Indentation for depth
-        std::cout << cstNodeTypeToString(type) << std::endl;
-        for (auto child : children) {
-            child->print(level + 1);
-        }
-    }
 };
 
 enum CSTTerminalNodeType {
@@ -86,10 +82,11 @@ enum CSTTerminalNodeType {
     ASTERISK,
     SLASH,
     NUMBER,
+    ERROR,
     END_OF_FILE,
 };
 
-std::string cstTerminalNodeTypeToString(CSTTerminalNodeType type) {
+inline std::string cstTerminalNodeTypeToString(CSTTerminalNodeType type) {
     switch (type) {
         case IDENTIFIER:
             return "IDENTIFIER";
@@ -119,6 +116,8 @@ std::string cstTerminalNodeTypeToString(CSTTerminalNodeType type) {
             return "SLASH";
         case NUMBER:
             return "NUMBER";
+        case ERROR:
+            return "ERROR";
         case END_OF_FILE:
             return "END_OF_FILE";
         default:
@@ -129,16 +128,24 @@ std::string cstTerminalNodeTypeToString(CSTTerminalNodeType type) {
 class CSTTerminalNode : public CSTNode {
 public:
     CSTTerminalNodeType type;
-    std::string value;
-    CSTTerminalNode(CSTTerminalNodeType type, const std::string &value) : CSTNode(CSTNodeType::TERMINAL), type(type), value(value) {}
-    CSTTerminalNode(CSTTerminalNodeType type) : CSTTerminalNode(type, "") {}
-    void print(int level = 0) const override  {
-        for (int i = 0; i < level; ++i) std::cout << "  ";  // Indentation for depth
-        std::cout << cstTerminalNodeTypeToString(type);
-        if (!value.empty()) {
-            std::cout << ": " << value;
+    std::string_view value;  // Spelling owned by the SymbolTable the lexer interned it into
+    uint32_t symbol;  // Interned symbol ID of value, or UINT32_MAX if the terminal has no value
+    bool hasInteger = false;  // The lexer decoded a literal into integer and kept no spelling
+    int64_t integer = 0;
+    size_t offset = 0;  // Of the terminal's first byte in the source, for diagnostics
+    CSTTerminalNode(CSTTerminalNodeType type, std::string_view value, uint32_t symbol) : CSTNode(CSTNodeType::TERMINAL), type(type), value(value), symbol(symbol) {}
+    CSTTerminalNode(CSTTerminalNodeType type) : CSTTerminalNode(type, "", UINT32_MAX) {}
+    CSTTerminalNode(CSTTerminalNodeType type, int64_t integer) : CSTTerminalNode(type) {
+        hasInteger = true;
+        this->integer = integer;
+    }
+
+    // value, or a decoded integer formatted into buffer
+    std::string_view spelling(char (&buffer)[24]) const {
+        if (!hasInteger) {
+            return value;
         }
-        std::cout << std::endl;
+        return std::string_view(buffer, std::to_chars(buffer, buffer + sizeof(buffer), integer).ptr - buffer);
     }
 };
 
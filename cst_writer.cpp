@@ -0,0 +1,179 @@
+#include "cst_writer.h"
+
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+CSTFormat parseCSTFormat(string_view name) {
+    if (name == "tree") {
+        return CSTFormat::TREE;
+    }
+    if (name == "sexpr") {
+        return CSTFormat::SEXPR;
+    }
+    if (name == "jsonl") {
+        return CSTFormat::JSON_LINES;
+    }
+    throw runtime_error("Unknown CST format: " + string(name));
+}
+
+CSTWriter::CSTWriter(FILE *out, size_t bufferSize) : out(out), bufferSize(bufferSize) {
+    buffer.reserve(bufferSize);
+}
+
+CSTWriter::~CSTWriter() {
+    flush();
+}
+
+void CSTWriter::flush() {
+    fwrite(buffer.data(), 1, buffer.size(), out);
+    buffer.clear();
+    fflush(out);
+}
+
+void CSTWriter::append(string_view text) {
+    buffer.append(text);
+    if (buffer.size() >= bufferSize) {
+        fwrite(buffer.data(), 1, buffer.size(), out);
+        buffer.clear();
+    }
+}
+
+void CSTWriter::appendQuoted(string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    append("\"");
+    bool plain = true;
+    for (char c : text) {
+        plain = plain && c != '"' && c != '\\' && (unsigned char)c >= 0x20;
+    }
+    if (plain) {
+        append(text);
+        append("\"");
+        return;
+    }
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            char escaped[] = {'\\', c};
+            append(string_view(escaped, 2));
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf]};
+            append(string_view(escaped, 6));
+        } else {
+            append(string_view(&c, 1));
+        }
+    }
+    append("\"");
+}
+
+void CSTWriter::appendNumber(size_t value) {
+    char digits[20];
+    size_t length = 0;
+    do {
+        digits[sizeof(digits) - ++length] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    append(string_view(digits + sizeof(digits) - length, length));
+}
+
+void CSTWriter::write(const CSTNode *root, CSTFormat format) {
+    // Names are looked up once instead of built per node
+    vector<string> nodeNames, terminalNames;
+    for (int type = 0; type <= CSTNodeType::TERMINAL; ++type) {
+        nodeNames.push_back(cstNodeTypeToString((CSTNodeType)type));
+    }
+    for (int type = 0; type <= CSTTerminalNodeType::END_OF_FILE; ++type) {
+        terminalNames.push_back(cstTerminalNodeTypeToString((CSTTerminalNodeType)type));
+    }
+
+    struct Frame {
+        const CSTNode *node;  // Null for the closing parenthesis of an S-expression
+        size_t depth;
+        size_t parent;
+    };
+    vector<Frame> pending = {{root, 0, SIZE_MAX}};
+    size_t nextId = 0;
+    bool needSpace = false;
+
+    while (!pending.empty()) {
+        Frame frame = pending.back();
+        pending.pop_back();
+        if (frame.node == nullptr) {
+            append(")");
+            continue;
+        }
+
+        const CSTNode *node = frame.node;
+        size_t id = nextId++;
+        bool terminal = node->type == CSTNodeType::TERMINAL;
+        bool leaf = node->children.empty();  // Only ERROR terminals have children
+        string_view name = terminal ? terminalNames[static_cast<const CSTTerminalNode *>(node)->type] : nodeNames[node->type];
+        char buffer[24];
+        string_view value = terminal ? static_cast<const CSTTerminalNode *>(node)->spelling(buffer) : string_view();
+
+        switch (format) {
+            case CSTFormat::TREE:
+                for (size_t i = 0; i < frame.depth; ++i) {
+                    append("  ");
+                }
+                append(name);
+                if (!value.empty()) {
+                    append(": ");
+                    append(value);
+                }
+                append("\n");
+                break;
+
+            case CSTFormat::SEXPR:
+                if (needSpace) {
+                    append(" ");
+                }
+                needSpace = true;
+                if (terminal && leaf && value.empty()) {
+                    append(name);
+                    break;
+                }
+                append("(");
+                append(name);
+                if (terminal && leaf) {
+                    append(" ");
+                    appendQuoted(value);
+                    append(")");
+                } else {
+                    pending.push_back({nullptr, 0, 0});
+                }
+                break;
+
+            case CSTFormat::JSON_LINES:
+                append("{\"id\":");
+                appendNumber(id);
+                append(",\"parent\":");
+                if (frame.parent == SIZE_MAX) {
+                    append("null");
+                } else {
+                    appendNumber(frame.parent);
+                }
+                append(",\"type\":");
+                appendQuoted(name);
+                if (terminal && !value.empty()) {
+                    append(",\"value\":");
+                    appendQuoted(value);
+                }
+                append("}\n");
+                break;
+        }
+
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            pending.push_back({*child, frame.depth + 1, id});
+        }
+    }
+
+    if (format == CSTFormat::SEXPR) {
+        append("\n");
+    }
+}
+
+void writeCST(const CSTNode *root, CSTFormat format) {
+    CSTWriter writer(stdout);
+    writer.write(root, format);
+}
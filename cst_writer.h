@@ -0,0 +1,44 @@
+#ifndef CST_WRITER_H
+#define CST_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "cst.h"
+
+enum class CSTFormat {
+    TREE,  // One node per line, indented by depth
+    SEXPR,  // Compact S-expression on a single line
+    JSON_LINES,  // One JSON object per node in pre-order: {"id", "parent", "type"[, "value"]}
+};
+
+// Parses "tree", "sexpr" or "jsonl". Throws runtime_error for anything else.
+CSTFormat parseCSTFormat(std::string_view name);
+
+// Streams a CST to out in any format through one iterative walk. Output is
+// collected in a large buffer and handed to out in big writes.
+class CSTWriter {
+public:
+    explicit CSTWriter(std::FILE *out, size_t bufferSize = 1 << 20);
+    CSTWriter(const CSTWriter &) = delete;
+    CSTWriter &operator=(const CSTWriter &) = delete;
+    ~CSTWriter();
+
+    void write(const CSTNode *root, CSTFormat format);
+    void flush();
+
+private:
+    void append(std::string_view text);
+    void appendQuoted(std::string_view text);  // As a JSON string
+    void appendNumber(size_t value);
+
+    std::FILE *out;
+    std::string buffer;
+    size_t bufferSize;
+};
+
+// Convenience wrapper writing to stdout
+void writeCST(const CSTNode *root, CSTFormat format);
+
+#endif // CST_WRITER_H
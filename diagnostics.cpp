@@ -0,0 +1,81 @@
+#include "diagnostics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCRIPT_DIAGNOSTICS_X86 1
+#include <immintrin.h>
+#else
+#define SCRIPT_DIAGNOSTICS_X86 0
+#endif
+
+using namespace std;
+
+SyntaxError::SyntaxError(const string &reason, size_t offset)
+    : runtime_error("Parsing error at byte " + to_string(offset) + ": " + reason), reason(reason), offset(offset) {}
+
+// Appends the offset after every newline in text[start, end) to lineStarts
+static void scanScalar(string_view text, size_t start, vector<size_t> &lineStarts) {
+    const char *begin = text.data();
+    const char *end = begin + text.size();
+    for (const char *p = begin + start; (p = (const char *)memchr(p, '\n', end - p)) != nullptr; ++p) {
+        lineStarts.push_back(p - begin + 1);
+    }
+}
+
+#if SCRIPT_DIAGNOSTICS_X86
+
+// One compare and movemask per block, then one iteration per newline found
+__attribute__((target("avx2"))) static void scanAVX2(string_view text, vector<size_t> &lineStarts) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= text.size(); i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(text.data() + i));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        for (; mask != 0; mask &= mask - 1) {
+            lineStarts.push_back(i + countr_zero(mask) + 1);
+        }
+    }
+    scanScalar(text, i, lineStarts);
+}
+
+static void scanSSE2(string_view text, vector<size_t> &lineStarts) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= text.size(); i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(text.data() + i));
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        for (; mask != 0; mask &= mask - 1) {
+            lineStarts.push_back(i + countr_zero(mask) + 1);
+        }
+    }
+    scanScalar(text, i, lineStarts);
+}
+
+#endif
+
+SourceLocation LineIndex::locate(size_t offset) {
+    if (lineStarts.empty()) {
+        lineStarts.push_back(0);
+#if SCRIPT_DIAGNOSTICS_X86
+        if (__builtin_cpu_supports("avx2")) {
+            scanAVX2(source, lineStarts);
+        } else {
+            scanSSE2(source, lineStarts);
+        }
+#else
+        scanScalar(source, 0, lineStarts);
+#endif
+    }
+    offset = min(offset, source.size());
+    size_t line = upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin();
+    return {line, offset - lineStarts[line - 1] + 1};
+}
+
+string LineIndex::describe(const SyntaxError &error) {
+    SourceLocation location = locate(error.offset);
+    return "Parsing error at line " + to_string(location.line) + ", column " + to_string(location.column) + ": " +
+           error.reason;
+}
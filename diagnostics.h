@@ -0,0 +1,43 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Thrown on a lexing or parsing error. Tokens only carry byte offsets, so
+// what() gives the offset; LineIndex::describe() turns it into a line and
+// column when the source is at hand.
+class SyntaxError : public std::runtime_error {
+public:
+    SyntaxError(const std::string &reason, size_t offset);
+
+    std::string reason;  // What is wrong, without a location
+    size_t offset;  // Of the first byte of the offending token
+};
+
+struct SourceLocation {
+    size_t line;  // 1-based
+    size_t column;  // 1-based, in bytes
+};
+
+// Maps byte offsets of a source to lines and columns. Nothing is computed
+// until the first lookup, which finds every newline in one vectorized scan;
+// each lookup is then a binary search. The source must outlive the index.
+class LineIndex {
+public:
+    explicit LineIndex(std::string_view source) : source(source) {}
+
+    SourceLocation locate(size_t offset);
+
+    // "Parsing error at line L, column C: reason"
+    std::string describe(const SyntaxError &error);
+
+private:
+    std::string_view source;
+    std::vector<size_t> lineStarts;  // Empty until the first lookup
+};
+
+#endif // DIAGNOSTICS_H
@@ -0,0 +1,371 @@
+#ifndef GLR_DRIVER_H
+#define GLR_DRIVER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "lr_driver.h"
+
+// Generalized LR driver for tables generated with parser_generator --glr,
+// where a cell may hold several actions: every alternative is followed at
+// once on a graph-structured stack (GSS), and the result is a shared packed
+// parse forest (SPPF) holding every parse of the input.
+//
+// A conflicted cell holds LR_ACCEPT + 1 + k for conflict k, whose actions are
+// Tables::conflictActions[conflictStart[k]] up to conflictStart[k + 1]. As
+// long as there is a single stack and no conflicted cell is hit, the driver
+// takes plain LR steps; the full GLR machinery only runs where the input
+// actually forks.
+//
+// Forest symbols are numbered as in parse_tables.h: terminals first, then
+// nonterminal n as NUM_TERMINALS + n. Everything is allocated in the arena
+// given to the driver.
+
+struct SPPFNode;
+
+// One derivation of an SPPFNode
+struct SPPFPacked {
+    int rule;
+    std::span<SPPFNode *> children;
+    SPPFPacked *next;
+};
+
+struct SPPFNode {
+    int symbol;
+    uint32_t start, end;  // Tokens [start, end)
+    SPPFPacked *alternatives;  // Null for terminals; more than one where ambiguous
+};
+
+template <typename Tables, typename Lexer>
+class GLRDriver {
+public:
+    using Token = typename Lexer::Token;
+
+    static constexpr int TERMINAL_COUNT = std::size(Tables::terminalNames);
+
+    GLRDriver(Lexer &lexer, Arena &arena) : lexer(lexer), arena(arena) {}
+
+    // Returns the forest of the start symbol over the whole input. Throws
+    // LRSyntaxError if no stack survives a token, which is then the last of
+    // tokens().
+    SPPFNode *parse() {
+        tokenList.clear();
+        frontier.assign(1, newNode(0, 0));
+        stackCount = 1;
+        for (uint32_t position = 0;; ++position) {
+            tokenList.push_back(lexer.next());
+            terminal = Lexer::terminal(tokenList.back());
+            leaf = nullptr;
+            SPPFNode *root = nullptr;
+            if (frontier.size() == 1) {
+                Step step = deterministicSteps(position, root);
+                if (step == Step::ACCEPTED) {
+                    return root;
+                }
+                if (step == Step::SHIFTED) {
+                    continue;
+                }
+            }
+            if ((root = generalStep(position))) {
+                return root;
+            }
+            if (frontier.empty()) {
+                throw LRSyntaxError(Tables::terminalNames[terminal]);
+            }
+        }
+    }
+
+    // Every token read, indexed by the positions in the forest
+    const std::vector<Token> &tokens() const { return tokenList; }
+
+    // The most stack tops there were at one position; 1 if the input never
+    // forked
+    size_t maxStacks() const { return stackCount; }
+
+private:
+    struct GSSNode;
+
+    struct GSSLink {
+        GSSNode *to;
+        SPPFNode *node;
+        GSSLink *next;
+    };
+
+    struct GSSNode {
+        int state;
+        uint32_t position;
+        GSSLink *links;
+        bool pending;  // Its actions for the current token are still to run
+    };
+
+    enum class Step { SHIFTED, ACCEPTED, FORKED };
+
+    static bool isConflict(int16_t action) {
+        return action > LR_ACCEPT && action <= LR_ACCEPT + Tables::conflictCount;
+    }
+
+    static std::span<const int16_t> actionsOf(int state, int terminal) {
+        const int16_t &action = Tables::actions[state][terminal];
+        if (isConflict(action)) {
+            int k = action - LR_ACCEPT - 1;
+            return {Tables::conflictActions + Tables::conflictStart[k],
+                    Tables::conflictActions + Tables::conflictStart[k + 1]};
+        }
+        return action == LR_ERROR ? std::span<const int16_t>() : std::span<const int16_t>(&action, 1);
+    }
+
+    GSSNode *newNode(int state, uint32_t position) { return arena.make<GSSNode>(state, position, nullptr, false); }
+
+    GSSLink *addLink(GSSNode *from, GSSNode *to, SPPFNode *node) {
+        from->links = arena.make<GSSLink>(to, node, from->links);
+        return from->links;
+    }
+
+    // The current token's forest node, made on its first shift
+    SPPFNode *terminalNode(uint32_t position) {
+        if (leaf == nullptr) {
+            leaf = arena.make<SPPFNode>(terminal, position, position + 1, nullptr);
+        }
+        return leaf;
+    }
+
+    void addAlternative(SPPFNode *node, int rule, std::span<SPPFNode *const> children) {
+        for (SPPFPacked *packed = node->alternatives; packed != nullptr; packed = packed->next) {
+            if (packed->rule == rule && std::equal(children.begin(), children.end(), packed->children.begin())) {
+                return;
+            }
+        }
+        std::span<SPPFNode *> copy = arena.makeArray<SPPFNode *>(children.size());
+        std::copy(children.begin(), children.end(), copy.begin());
+        node->alternatives = arena.make<SPPFPacked>(rule, copy, node->alternatives);
+    }
+
+    // Plain LR on the only stack, until the token is shifted or accepted or
+    // the stack would have to fork. On FORKED, frontier holds the current top
+    // for generalStep(), which also reports errors.
+    Step deterministicSteps(uint32_t position, SPPFNode *&root) {
+        GSSNode *top = frontier[0];
+        while (true) {
+            int16_t action = Tables::actions[top->state][terminal];
+            if (action > 0) {
+                GSSNode *next = newNode(action, position + 1);
+                addLink(next, top, terminalNode(position));
+                frontier[0] = next;
+                return Step::SHIFTED;
+            }
+            if (action == LR_ACCEPT) {
+                root = top->links->node;
+                return Step::ACCEPTED;
+            }
+            if (action == LR_ERROR || isConflict(action)) {
+                frontier[0] = top;
+                return Step::FORKED;
+            }
+
+            int rule = -action - 1;
+            int length = Tables::ruleLength[rule];
+            path.resize(length);
+            GSSNode *bottom = top;
+            for (int i = length - 1; i >= 0; --i) {
+                if (bottom->links->next != nullptr) {
+                    frontier[0] = top;  // Stacks merged below, so there are several paths
+                    return Step::FORKED;
+                }
+                path[i] = bottom->links->node;
+                bottom = bottom->links->to;
+            }
+            int lhs = Tables::ruleLhs[rule];
+            SPPFNode *node = arena.make<SPPFNode>(TERMINAL_COUNT + lhs, bottom->position, position, nullptr);
+            addAlternative(node, rule, path);
+            top = newNode(Tables::gotos[bottom->state][lhs], position);
+            addLink(top, bottom, node);
+        }
+    }
+
+    // One token of Tomita's algorithm: run every stack's actions, reducing
+    // along every path of the GSS and merging stacks that reach the same
+    // state, then shift the survivors. Returns the root on acceptance.
+    SPPFNode *generalStep(uint32_t position) {
+        shared.clear();
+        shifts.clear();
+        pending.clear();
+        GSSNode *accepted = nullptr;
+        for (GSSNode *node : frontier) {
+            node->pending = true;
+            pending.push_back(node);
+        }
+        while (!pending.empty()) {
+            GSSNode *node = pending.back();
+            pending.pop_back();
+            node->pending = false;
+            for (int16_t action : actionsOf(node->state, terminal)) {
+                if (action > 0) {
+                    shifts.push_back({node, action});
+                } else if (action == LR_ACCEPT) {
+                    accepted = node;
+                } else {
+                    reduce(node, -action - 1, nullptr, position);
+                }
+            }
+        }
+        stackCount = std::max(stackCount, frontier.size());
+        if (accepted != nullptr) {
+            return accepted->links->node;
+        }
+
+        nextFrontier.clear();
+        for (auto [node, state] : shifts) {
+            GSSNode *next = findNode(nextFrontier, state);
+            if (next == nullptr) {
+                next = newNode(state, position + 1);
+                nextFrontier.push_back(next);
+            }
+            addLink(next, node, terminalNode(position));
+        }
+        frontier.swap(nextFrontier);
+        return nullptr;
+    }
+
+    static GSSNode *findNode(const std::vector<GSSNode *> &nodes, int state) {
+        for (GSSNode *node : nodes) {
+            if (node->state == state) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    // Reduces by rule along every path down from node, or only those through
+    // the link `through` when it is given
+    void reduce(GSSNode *node, int rule, GSSLink *through, uint32_t position) {
+        std::vector<SPPFNode *> children(Tables::ruleLength[rule]);
+        walkPaths(node, children.size(), through == nullptr, through, children, rule, position);
+    }
+
+    void walkPaths(GSSNode *node, size_t remaining, bool usedLink, GSSLink *through, std::vector<SPPFNode *> &children,
+                   int rule, uint32_t position) {
+        if (remaining == 0) {
+            if (usedLink) {
+                reducePath(node, rule, children, position);
+            }
+            return;
+        }
+        for (GSSLink *link = node->links; link != nullptr; link = link->next) {
+            children[remaining - 1] = link->node;
+            walkPaths(link->to, remaining - 1, usedLink || link == through, through, children, rule, position);
+        }
+    }
+
+    void reducePath(GSSNode *bottom, int rule, std::span<SPPFNode *const> children, uint32_t position) {
+        int lhs = Tables::ruleLhs[rule];
+        int state = Tables::gotos[bottom->state][lhs];
+
+        // One forest node per symbol and extent, whichever stacks derive it
+        SPPFNode *&node = shared[(uint64_t)lhs << 32 | bottom->position];
+        if (node == nullptr) {
+            node = arena.make<SPPFNode>(TERMINAL_COUNT + lhs, bottom->position, position, nullptr);
+        }
+        addAlternative(node, rule, children);
+
+        GSSNode *top = findNode(frontier, state);
+        if (top == nullptr) {
+            top = newNode(state, position);
+            addLink(top, bottom, node);
+            top->pending = true;
+            frontier.push_back(top);
+            pending.push_back(top);
+            return;
+        }
+        for (GSSLink *link = top->links; link != nullptr; link = link->next) {
+            if (link->to == bottom) {
+                return;  // The new alternative is already packed into link->node
+            }
+        }
+
+        // Stacks that already ran their reductions may have new paths down
+        // through this link
+        GSSLink *link = addLink(top, bottom, node);
+        for (size_t i = 0, count = frontier.size(); i < count; ++i) {
+            GSSNode *other = frontier[i];
+            if (other->pending) {
+                continue;
+            }
+            for (int16_t action : actionsOf(other->state, terminal)) {
+                if (action < 0 && action != LR_ACCEPT && Tables::ruleLength[-action - 1] > 0) {
+                    reduce(other, -action - 1, link, position);
+                }
+            }
+        }
+    }
+
+    Lexer &lexer;
+    Arena &arena;
+    std::vector<Token> tokenList;
+    std::vector<GSSNode *> frontier;  // Stack tops at the current position
+    std::vector<GSSNode *> nextFrontier;
+    std::vector<GSSNode *> pending;
+    std::vector<std::pair<GSSNode *, int>> shifts;
+    std::unordered_map<uint64_t, SPPFNode *> shared;  // (lhs, start) -> node ending at the current position
+    std::vector<SPPFNode *> path;
+    int terminal = 0;  // Of the current token
+    SPPFNode *leaf = nullptr;
+    size_t stackCount = 1;
+};
+
+// Prints every node of a forest once, with its derivations. tokenText(i)
+// gives the text of token i.
+//
+//   #4 expression [0, 3)
+//       expression -> expression PLUS term : #5 #6 #7
+//       expression -> term : #8
+template <typename Tables, typename TokenText>
+void printForest(const SPPFNode *root, TokenText tokenText, std::ostream &out = std::cout) {
+    constexpr int terminalCount = std::size(Tables::terminalNames);
+    std::unordered_map<const SPPFNode *, size_t> ids;
+    auto idOf = [&](const SPPFNode *node) {
+        auto [it, inserted] = ids.try_emplace(node, ids.size());
+        return std::pair(it->second, inserted);
+    };
+
+    std::vector<const SPPFNode *> pending = {root};
+    idOf(root);
+    while (!pending.empty()) {
+        const SPPFNode *node = pending.back();
+        pending.pop_back();
+        out << "#" << ids[node] << " ";
+        if (node->symbol < terminalCount) {
+            out << Tables::terminalNames[node->symbol];
+            std::string_view text = tokenText(node->start);
+            if (!text.empty()) {
+                out << " \"" << text << "\"";
+            }
+        } else {
+            out << Tables::nonTerminalNames[node->symbol - terminalCount];
+        }
+        out << " [" << node->start << ", " << node->end << ")\n";
+
+        std::vector<const SPPFNode *> unseen;
+        for (const SPPFPacked *packed = node->alternatives; packed != nullptr; packed = packed->next) {
+            out << "    " << Tables::ruleText[packed->rule] << ":";
+            for (const SPPFNode *child : packed->children) {
+                auto [id, inserted] = idOf(child);
+                out << " #" << id;
+                if (inserted) {
+                    unseen.push_back(child);
+                }
+            }
+            out << "\n";
+        }
+        pending.insert(pending.end(), unseen.rbegin(), unseen.rend());
+    }
+}
+
+#endif // GLR_DRIVER_H
@@ -2,8 +2,11 @@
 #define PARSER_H
 
 #include <algorithm>
+#include <cstdint>
 #include <string>
+#include <charconv>
 #include <map>
+#include <string_view>
 #include <vector>
 #include <iostream>
 
@@ -11,106 +14,93 @@ namespace GrammarParser {
 
 #include "grammar_cst.h"
 
-struct Action {
-    enum ActionType {
-        SHIFT,
-        REDUCE,
-        ACCEPT,
-        NONE
-    };
-    ActionType actionType;
-    int stateOrRule; // For SHIFT: state; For REDUCE: rule index
-};
-
-struct Goto {
-    int state;  // The state to go to for a non-terminal
-};
-
-struct Rule {
-    std::string lhs;  // Left-hand side of the rule
-    std::vector<std::string> rhs;  // Right-hand side of the rule (sequence of symbols)
-};
-
-static const int NUM_TERMINALS = 5;
+static const int NUM_TERMINALS = 6;
 static const int NUM_NON_TERMINALS = 6;
-static const int NUM_STATES = 14;
-
-static const std::map<std::string, int> terminalToID = {
-    {"COLON", 1},
-    {"END_OF_FILE", 4},
-    {"IDENTIFIER", 0},
-    {"SEMICOLON", 2},
-    {"VERTICAL_BAR", 3},
-};
+static const int NUM_STATES = 15;
+static const int NUM_RULES = 10;
+
+// Tables for LRDriver (lr_driver.h). Actions: 0 is an error, n > 0 shifts to
+// state n, n < 0 reduces by rule -n - 1 and INT16_MIN accepts.
+struct ParserTables {
+    static constexpr const char *terminalNames[NUM_TERMINALS] = {
+        "IDENTIFIER",
+        "COLON",
+        "SEMICOLON",
+        "VERTICAL_BAR",
+        "ACTION",
+        "END_OF_FILE",
+    };
 
-static const std::map<std::string, int> nonTerminalToID = {
-    {"grammar", 0},
-    {"identifierList", 5},
-    {"option", 4},
-    {"optionList", 3},
-    {"rule", 2},
-    {"ruleList", 1},
-};
+    static constexpr const char *nonTerminalNames[NUM_NON_TERMINALS] = {
+        "grammar",
+        "ruleList",
+        "rule",
+        "optionList",
+        "option",
+        "identifierList",
+    };
 
-static const std::vector<std::vector<Action>> actionTable = {
-    { {Action::SHIFT, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::SHIFT, 4}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::REDUCE, 2}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 2}, },
-    { {Action::SHIFT, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::ACCEPT, -1}, },
-    { {Action::SHIFT, 6}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::REDUCE, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 1}, },
-    { {Action::REDUCE, 8}, {Action::NONE, -1}, {Action::REDUCE, 8}, {Action::REDUCE, 8}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 10}, {Action::NONE, -1}, {Action::REDUCE, 6}, {Action::REDUCE, 6}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 5}, {Action::REDUCE, 5}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 11}, {Action::SHIFT, 12}, {Action::NONE, -1}, },
-    { {Action::REDUCE, 7}, {Action::NONE, -1}, {Action::REDUCE, 7}, {Action::REDUCE, 7}, {Action::NONE, -1}, },
-    { {Action::REDUCE, 3}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 3}, },
-    { {Action::SHIFT, 6}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 4}, {Action::REDUCE, 4}, {Action::NONE, -1}, },
-};
+    static constexpr const char *ruleText[NUM_RULES] = {
+        "grammar -> ruleList ",
+        "ruleList -> ruleList rule ",
+        "ruleList -> rule ",
+        "rule -> IDENTIFIER COLON optionList SEMICOLON ",
+        "optionList -> optionList VERTICAL_BAR option ",
+        "optionList -> option ",
+        "option -> identifierList ",
+        "option -> identifierList ACTION ",
+        "identifierList -> identifierList IDENTIFIER ",
+        "identifierList -> IDENTIFIER ",
+    };
 
-static const std::vector<std::vector<Goto>> gotoTable = {
-    { {-1}, {3}, {2}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {5}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {9}, {8}, {7}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {13}, {7}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-};
+    static constexpr uint16_t ruleLength[NUM_RULES] = { 1, 2, 1, 4, 3, 1, 1, 2, 2, 1, };
+    static constexpr uint16_t ruleLhs[NUM_RULES] = { 0, 1, 1, 2, 3, 3, 4, 4, 5, 5, };
+
+    static constexpr int16_t actions[NUM_STATES][NUM_TERMINALS] = {
+        { 1, 0, 0, 0, 0, 0, },
+        { 0, 4, 0, 0, 0, 0, },
+        { -3, 0, 0, 0, 0, -3, },
+        { 1, 0, 0, 0, 0, -32768, },
+        { 6, 0, 0, 0, 0, 0, },
+        { -2, 0, 0, 0, 0, -2, },
+        { -10, 0, -10, -10, -10, 0, },
+        { 11, 0, -7, -7, 10, 0, },
+        { 0, 0, -6, -6, 0, 0, },
+        { 0, 0, 12, 13, 0, 0, },
+        { 0, 0, -8, -8, 0, 0, },
+        { -9, 0, -9, -9, -9, 0, },
+        { -4, 0, 0, 0, 0, -4, },
+        { 6, 0, 0, 0, 0, 0, },
+        { 0, 0, -5, -5, 0, 0, },
+    };
 
-static const std::map<int, int> ruleSymbolCount = {
-    {0, 1},
-    {1, 2},
-    {2, 1},
-    {3, 4},
-    {4, 3},
-    {5, 1},
-    {6, 1},
-    {7, 2},
-    {8, 1},
-};
+    static constexpr int conflictCount = 0;
+    static constexpr uint16_t conflictStart[conflictCount + 1] = { 0, };
+    static constexpr int16_t conflictActions[1] = { 0, };
+
+    static constexpr int16_t gotos[NUM_STATES][NUM_NON_TERMINALS] = {
+        { -1, 3, 2, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, 5, -1, -1, -1, },
+        { -1, -1, -1, 9, 8, 7, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, 14, 7, },
+        { -1, -1, -1, -1, -1, -1, },
+    };
 
-static const std::vector<Rule> grammar = {
-    {"grammar", {"ruleList"}},
-    {"ruleList", {"ruleList", "rule"}},
-    {"ruleList", {"rule"}},
-    {"rule", {"IDENTIFIER", "COLON", "optionList", "SEMICOLON"}},
-    {"optionList", {"optionList", "VERTICAL_BAR", "option"}},
-    {"optionList", {"option"}},
-    {"option", {"identifierList"}},
-    {"identifierList", {"identifierList", "IDENTIFIER"}},
-    {"identifierList", {"IDENTIFIER"}},
+    static constexpr uint16_t generatorStates[NUM_STATES] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, };
 };
 
 std::string readFile(const std::string &filename);
+// Terminal values point into input, which must outlive the tokens
 std::vector<CSTNode *> tokenize(const std::string &input);
 CSTNode* parse(const std::vector<CSTNode *>& input);
 
@@ -0,0 +1,238 @@
+#include "jit.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define SCRIPT_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define SCRIPT_JIT_SUPPORTED 0
+#endif
+
+using namespace std;
+
+bool JIT::isSupported() {
+    return SCRIPT_JIT_SUPPORTED;
+}
+
+#if SCRIPT_JIT_SUPPORTED
+
+namespace {
+
+// Emits the handful of x86-64 encodings the code generator needs. Every
+// bytecode register lives in a 32-bit stack slot at [rbp - 4 * (r + 1)];
+// eax is the accumulator and ecx the second operand.
+class Assembler {
+public:
+    vector<uint8_t> code;
+
+    void bytes(initializer_list<uint8_t> values) { code.insert(code.end(), values); }
+
+    void imm32(int32_t value) {
+        uint8_t buffer[4];
+        memcpy(buffer, &value, 4);
+        code.insert(code.end(), buffer, buffer + 4);
+    }
+
+    static int32_t slot(uint32_t reg) { return -4 * (int32_t)(reg + 1); }
+
+    // op r32, [rbp + disp32] / op [rbp + disp32], r32 with a ModRM reg field
+    void rbpOperand(initializer_list<uint8_t> opcode, uint8_t reg, uint32_t bytecodeRegister) {
+        bytes(opcode);
+        code.push_back(0x85 | (uint8_t)((reg & 7) << 3));
+        imm32(slot(bytecodeRegister));
+    }
+
+    void prologue(uint32_t frameBytes) {
+        bytes({0x55});  // push rbp
+        bytes({0x48, 0x89, 0xE5});  // mov rbp, rsp
+        bytes({0x48, 0x81, 0xEC});  // sub rsp, imm32
+        imm32(frameBytes);
+    }
+
+    // Stores the i-th SysV integer argument register into its slot
+    void spillArgument(uint32_t index) {
+        static const uint8_t argumentRegisters[JIT::MAX_PARAMS] = {7, 6, 2, 1, 0, 1};  // edi esi edx ecx r8d r9d
+        if (index >= 4) {
+            code.push_back(0x44);  // REX.R selects r8d/r9d
+        }
+        rbpOperand({0x89}, argumentRegisters[index], index);
+    }
+
+    void epilogue() {
+        bytes({0xC9});  // leave
+        bytes({0xC3});  // ret
+    }
+};
+
+class NativeCompiler {
+public:
+    explicit NativeCompiler(const BytecodeFunction &function) : function(function) {}
+
+    vector<uint8_t> compile() {
+        uint32_t frameBytes = (4 * function.registerCount + 15) & ~15u;
+        assembler.prologue(frameBytes);
+        for (uint32_t i = 0; i < function.paramCount; ++i) {
+            assembler.spillArgument(i);
+        }
+
+        for (const Instruction &instruction : function.code) {
+            if (instruction.opcode == OP_RETURN) {
+                loadEax(instruction.a);
+                assembler.epilogue();
+                break;
+            }
+            loadEax(instruction.a);
+            switch (instruction.opcode) {
+                case OP_ADD:
+                    arithmetic(0x05, {0x03}, instruction.b);  // add eax, imm32 / add eax, [slot]
+                    break;
+                case OP_SUBTRACT:
+                    arithmetic(0x2D, {0x2B}, instruction.b);  // sub eax, imm32 / sub eax, [slot]
+                    break;
+                case OP_MULTIPLY:
+                    if (isConstant(instruction.b)) {
+                        assembler.bytes({0x69, 0xC0});  // imul eax, eax, imm32
+                        assembler.imm32(constant(instruction.b));
+                    } else {
+                        assembler.rbpOperand({0x0F, 0xAF}, 0, instruction.b);  // imul eax, [slot]
+                    }
+                    break;
+                case OP_DIVIDE:
+                    divide(instruction.b);
+                    break;
+            }
+            assembler.rbpOperand({0x89}, 0, instruction.dst);  // mov [slot], eax
+        }
+        return move(assembler.code);
+    }
+
+private:
+    bool isConstant(uint32_t reg) const {
+        return reg >= function.paramCount && reg < function.paramCount + function.constants.size();
+    }
+
+    int32_t constant(uint32_t reg) const { return function.constants[reg - function.paramCount]; }
+
+    void loadEax(uint32_t reg) {
+        if (isConstant(reg)) {
+            assembler.bytes({0xB8});  // mov eax, imm32
+            assembler.imm32(constant(reg));
+        } else {
+            assembler.rbpOperand({0x8B}, 0, reg);  // mov eax, [slot]
+        }
+    }
+
+    void arithmetic(uint8_t immediateOpcode, initializer_list<uint8_t> memoryOpcode, uint32_t reg) {
+        if (isConstant(reg)) {
+            assembler.bytes({immediateOpcode});
+            assembler.imm32(constant(reg));
+        } else {
+            assembler.rbpOperand(memoryOpcode, 0, reg);
+        }
+    }
+
+    // eax = eax / rhs with the script's rules for x / 0 and INT32_MIN / -1
+    void divide(uint32_t reg) {
+        if (isConstant(reg)) {
+            int32_t divisor = constant(reg);
+            if (divisor == 0) {
+                assembler.bytes({0x31, 0xC0});  // xor eax, eax
+                return;
+            }
+            if (divisor == -1) {
+                assembler.bytes({0xF7, 0xD8});  // neg eax
+                return;
+            }
+            assembler.bytes({0xB9});  // mov ecx, imm32
+            assembler.imm32(divisor);
+            assembler.bytes({0x99, 0xF7, 0xF9});  // cdq; idiv ecx
+            return;
+        }
+        assembler.rbpOperand({0x8B}, 1, reg);  // mov ecx, [slot]
+        assembler.bytes({
+            0x85, 0xC9,        //     test ecx, ecx
+            0x74, 0x0A,        //     jz zero
+            0x83, 0xF9, 0xFF,  //     cmp ecx, -1
+            0x74, 0x09,        //     je negate
+            0x99,              //     cdq
+            0xF7, 0xF9,        //     idiv ecx
+            0xEB, 0x06,        //     jmp done
+            0x31, 0xC0,        // zero: xor eax, eax
+            0xEB, 0x02,        //     jmp done
+            0xF7, 0xD8,        // negate: neg eax
+        });                    // done:
+    }
+
+    const BytecodeFunction &function;
+    Assembler assembler;
+};
+
+}  // namespace
+
+JIT::~JIT() {
+    for (const Mapping &mapping : mappings) {
+        munmap(mapping.address, mapping.size);
+    }
+}
+
+NativeFunction JIT::compile(const BytecodeFunction &function) {
+    if (function.paramCount > MAX_PARAMS) {
+        return nullptr;
+    }
+    vector<uint8_t> code = NativeCompiler(function).compile();
+
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t size = (code.size() + pageSize - 1) / pageSize * pageSize;
+    void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED) {
+        return nullptr;
+    }
+    memcpy(address, code.data(), code.size());
+    if (mprotect(address, size, PROT_READ | PROT_EXEC) != 0) {
+        // Executable mappings are forbidden here; stay in the interpreter
+        munmap(address, size);
+        return nullptr;
+    }
+    mappings.push_back({address, size});
+    return reinterpret_cast<NativeFunction>(address);
+}
+
+#else
+
+JIT::~JIT() {}
+
+NativeFunction JIT::compile(const BytecodeFunction &function) {
+    return nullptr;
+}
+
+#endif
+
+TieredExecutor::TieredExecutor(const BytecodeProgram &program, uint32_t jitThreshold)
+    : program(program), jitThreshold(jitThreshold), vm(program), tiers(program.functions.size()) {}
+
+int32_t TieredExecutor::call(string_view name, span<const int32_t> args) {
+    int functionIndex = program.findFunction(name);
+    if (functionIndex < 0) {
+        throw runtime_error("Unknown function: " + string(name));
+    }
+    return call((uint32_t)functionIndex, args);
+}
+
+int32_t TieredExecutor::call(uint32_t functionIndex, span<const int32_t> args) {
+    Tier &tier = tiers[functionIndex];
+    if (tier.native != nullptr && args.size() == program.functions[functionIndex].paramCount) {
+        int32_t padded[JIT::MAX_PARAMS] = {};
+        copy(args.begin(), args.end(), padded);
+        return tier.native(padded[0], padded[1], padded[2], padded[3], padded[4], padded[5]);
+    }
+    if (jitThreshold != JIT_DISABLED && tier.calls < jitThreshold && ++tier.calls == jitThreshold) {
+        // A failed compile leaves native unset, and the counter never reaches
+        // the threshold again, so the JIT is only attempted once per function
+        tier.native = jit.compile(program.functions[functionIndex]);
+    }
+    return vm.call(functionIndex, args);
+}
@@ -0,0 +1,74 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "bytecode.h"
+
+// Native code for a compiled script function. Parameters arrive in registers
+// following the SysV AMD64 ABI, so up to six of them are supported; unused
+// trailing arguments are ignored by the generated code.
+typedef int32_t (*NativeFunction)(int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
+
+// Translates bytecode functions into x86-64 machine code. The code is written
+// into a read-write mapping that is then flipped to read-execute, so a page
+// is never writable and executable at the same time.
+class JIT {
+public:
+    static constexpr uint32_t MAX_PARAMS = 6;
+
+    JIT() = default;
+    JIT(const JIT &) = delete;
+    JIT &operator=(const JIT &) = delete;
+    ~JIT();
+
+    // False when this build does not target x86-64 with POSIX mmap
+    static bool isSupported();
+
+    // Returns nullptr if the function cannot be compiled here: unsupported
+    // platform, too many parameters, or the OS refusing executable memory.
+    // The returned code stays valid as long as this JIT is alive.
+    NativeFunction compile(const BytecodeFunction &function);
+
+private:
+    struct Mapping {
+        void *address;
+        size_t size;
+    };
+    std::vector<Mapping> mappings;
+};
+
+// Runs functions in the VM until they have been called jitThreshold times,
+// then switches them to native code. Functions the JIT cannot handle keep
+// running in the VM, so results never depend on whether the JIT kicked in.
+class TieredExecutor {
+public:
+    static constexpr uint32_t DEFAULT_JIT_THRESHOLD = 1000;
+    static constexpr uint32_t JIT_DISABLED = UINT32_MAX;
+
+    explicit TieredExecutor(const BytecodeProgram &program, uint32_t jitThreshold = DEFAULT_JIT_THRESHOLD);
+
+    // Throws runtime_error for an unknown function or a wrong argument count
+    int32_t call(std::string_view name, std::span<const int32_t> args);
+    int32_t call(uint32_t functionIndex, std::span<const int32_t> args);
+
+    // Whether the function is currently running as native code
+    bool isCompiled(uint32_t functionIndex) const { return tiers[functionIndex].native != nullptr; }
+
+private:
+    struct Tier {
+        uint32_t calls = 0;
+        NativeFunction native = nullptr;
+    };
+
+    const BytecodeProgram &program;
+    uint32_t jitThreshold;
+    VM vm;
+    JIT jit;
+    std::vector<Tier> tiers;
+};
+
+#endif // JIT_H
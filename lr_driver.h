@@ -0,0 +1,399 @@
+#ifndef LR_DRIVER_H
+#define LR_DRIVER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "parse_profile.h"
+
+// Shared LR(1) driver for every generated parser.
+//
+// Tables is the traits struct parser_generator emits next to the tables
+// (ParserTables): the automaton as constexpr arrays, so each instantiation
+// indexes straight into static data. Actions are packed into an int16_t by
+// the generator:
+//
+//   0       error
+//   n > 0   shift and go to state n (state 0 is never a shift target)
+//   n < 0   reduce by rule -n - 1
+//   LR_ACCEPT
+//
+// Lexer supplies tokens:
+//   typename Lexer::Token
+//   Token next();  // Returns the end of file token once input runs out
+//   static int terminal(const Token &token);
+//
+// NodeBuilder decides what a parse produces:
+//   typename NodeBuilder::Node
+//   Node shift(const Token &token);
+//   Node reduce(int rule, int lhs, std::span<Node> children);
+//
+// The value of the accepted start symbol is returned by parse(). Callers
+// that receive input piecemeal drive LRAutomaton directly instead.
+//
+// A builder may also recover from syntax errors, if the grammar has rules
+// with the ERROR terminal (Tables::errorTerminal):
+//   Node error(const Token &token, int terminal, std::span<Node> popped);
+//   void skip(Node error, const Token &token);
+// On a token with no action, the automaton pops states until one can shift
+// ERROR, and shifts error() of the offending token and the popped nodes.
+// Tokens that still have no action are passed to skip() and dropped, until
+// one fits after the ERROR and parsing carries on. Each token starts at most
+// one recovery, the end of file two, and every node is popped at most once,
+// so however many errors there are, a parse stays linear in its input.
+// Builders without error() get LRSyntaxError instead.
+//
+// In a SCRIPT_PROFILING build, a driver given a ParseProfile counts state
+// visits, reductions and stack depth, and times the lexer and the builder
+// with the cycle counter. Without it, setProfile() is all that remains.
+
+static constexpr int16_t LR_ERROR = 0;
+static constexpr int16_t LR_ACCEPT = INT16_MIN;
+
+// Thrown by the drivers when a token has no action. Only the caller knows
+// where its tokens came from, so the location is left to it.
+class LRSyntaxError : public std::runtime_error {
+public:
+    explicit LRSyntaxError(const char *terminalName)
+        : std::runtime_error(std::string("Parsing error: Unexpected ") + terminalName + "."), terminalName(terminalName) {}
+
+    const char *terminalName;
+};
+
+// The automaton of LRDriver without a lexer, for callers that produce tokens
+// themselves. Each push() runs the reductions a token triggers and then
+// shifts it. Between pushes the whole parse is the two stacks, so a parse
+// suspends whenever its caller runs out of input and resumes with the next
+// push(), with no lexer, thread or call stack tied up in the meantime.
+template <typename Tables, typename NodeBuilder>
+class LRAutomaton {
+    static_assert(Tables::conflictCount == 0, "Tables generated with --glr conflicts need GLRDriver (glr_driver.h)");
+
+public:
+    using Node = typename NodeBuilder::Node;
+
+    explicit LRAutomaton(NodeBuilder &builder) : builder(builder) { reset(); }
+
+    // Counters are added to profile, which must have room for every state
+    // and rule of Tables. Ignored unless SCRIPT_PROFILING is set.
+    void setProfile(ParseProfile *profile) { this->profile = profile; }
+
+    // Discards any parse in progress and starts a new one
+    void reset() {
+        stateStack.clear();
+        nodeStack.clear();
+        stateStack.push_back(0);
+        errorNode = Node();
+        recovering = false;
+        recoveredAtEnd = false;
+    }
+
+    // Feeds the next token, whose terminal is given. Returns true once the
+    // end of file token has been accepted; result() is then the value of the
+    // start symbol, and reset() must come before the next push(). With Trace
+    // set, every action is printed to stdout. Throws LRSyntaxError if the
+    // token has no action, unless the builder recovers; then only if no state
+    // on the stack can shift ERROR.
+    template <bool Trace = false, typename Token>
+    bool push(const Token &token, int terminal) {
+        while (true) {
+            int state = stateStack.back();
+#if SCRIPT_PROFILING
+            if (profile) {
+                ++profile->stateVisits[state];
+            }
+#endif
+            if constexpr (Trace) {
+                std::cout << "Current State: " << state << ", Current Symbol: " << Tables::terminalNames[terminal] << std::endl;
+            }
+            int16_t action = Tables::actions[state][terminal];
+
+            if (action > 0) {
+                if constexpr (Trace) std::cout << "Action: SHIFT, Next State: " << action << std::endl;
+                stateStack.push_back(action);
+                nodeStack.push_back(shiftNode(token));
+                recovering = false;
+#if SCRIPT_PROFILING
+                if (profile) {
+                    ++profile->shifts;
+                    profile->maxStackDepth = std::max(profile->maxStackDepth, stateStack.size());
+                }
+#endif
+                return false;
+            } else if (action == LR_ACCEPT) {
+                if constexpr (Trace) std::cout << "Action: ACCEPT. Parsing is complete!" << std::endl;
+                return true;
+            } else if (action < 0) {
+                int rule = -action - 1;
+                int length = Tables::ruleLength[rule];
+                int lhs = Tables::ruleLhs[rule];
+                if constexpr (Trace) std::cout << "Action: REDUCE by rule " << rule << ": " << Tables::ruleText[rule] << std::endl;
+
+                std::span<Node> children(nodeStack.data() + nodeStack.size() - length, length);
+                Node parent = reduceNode(rule, lhs, children);
+#if SCRIPT_PROFILING
+                if (profile) {
+                    ++profile->reductions;
+                    ++profile->ruleReductions[rule];
+                }
+#endif
+                nodeStack.resize(nodeStack.size() - length);
+                stateStack.resize(stateStack.size() - length);
+
+                int nextState = Tables::gotos[stateStack.back()][lhs];
+                if constexpr (Trace) std::cout << "Goto state: " << nextState << std::endl;
+                stateStack.push_back(nextState);
+                nodeStack.push_back(parent);
+            } else if constexpr (requires { builder.error(token, terminal, std::span<Node>()); }) {
+                if (recovering && terminal != Tables::endOfFileTerminal) {
+                    if constexpr (Trace) std::cout << "Action: SKIP" << std::endl;
+                    builder.skip(errorNode, token);
+                    return false;
+                }
+                recover<Trace>(token, terminal);
+            } else {
+                throw LRSyntaxError(Tables::terminalNames[terminal]);
+            }
+        }
+    }
+
+    Node result() const { return nodeStack.back(); }
+
+    // States on the stack, including the start state
+    size_t depth() const { return stateStack.size(); }
+
+private:
+    // Pops to the nearest state that can shift ERROR and shifts an error node
+    // there. The end of file cannot be skipped, so for it the state must also
+    // have an action on END_OF_FILE after the ERROR. Canonical LR(1) tables
+    // only act on a lookahead that can follow, so that parse then accepts
+    // and the end of file recovers at most once.
+    template <bool Trace, typename Token>
+    void recover(const Token &token, int terminal) {
+        static_assert(Tables::errorTerminal >= 0, "A builder with error() needs a grammar with ERROR rules");
+        bool atEnd = terminal == Tables::endOfFileTerminal;
+        if (atEnd && recoveredAtEnd) {
+            throw LRSyntaxError(Tables::terminalNames[terminal]);
+        }
+        recoveredAtEnd = atEnd;
+
+        size_t keep = stateStack.size();
+        int16_t target = LR_ERROR;
+        for (; keep > 0; --keep) {
+            target = Tables::actions[stateStack[keep - 1]][Tables::errorTerminal];
+            if (target > 0 && (!atEnd || Tables::actions[target][terminal] != LR_ERROR)) {
+                break;
+            }
+        }
+        if (keep == 0) {
+            throw LRSyntaxError(Tables::terminalNames[terminal]);
+        }
+        if constexpr (Trace) std::cout << "Action: RECOVER in state " << stateStack[keep - 1] << ", Next State: " << target << std::endl;
+
+        // The node stack lacks the start state's entry
+        std::span<Node> popped(nodeStack.data() + keep - 1, nodeStack.size() - (keep - 1));
+        errorNode = builder.error(token, terminal, popped);
+        nodeStack.resize(keep - 1);
+        stateStack.resize(keep);
+        stateStack.push_back(target);
+        nodeStack.push_back(errorNode);
+        recovering = true;
+    }
+
+    template <typename Token>
+    Node shiftNode(const Token &token) {
+#if SCRIPT_PROFILING
+        if (profile) {
+            uint64_t start = readCycleCounter();
+            Node node = builder.shift(token);
+            profile->nodeCycles += readCycleCounter() - start;
+            return node;
+        }
+#endif
+        return builder.shift(token);
+    }
+
+    Node reduceNode(int rule, int lhs, std::span<Node> children) {
+#if SCRIPT_PROFILING
+        if (profile) {
+            uint64_t start = readCycleCounter();
+            Node node = builder.reduce(rule, lhs, children);
+            profile->nodeCycles += readCycleCounter() - start;
+            return node;
+        }
+#endif
+        return builder.reduce(rule, lhs, children);
+    }
+
+    NodeBuilder &builder;
+    ParseProfile *profile = nullptr;
+    std::vector<int> stateStack;
+    std::vector<Node> nodeStack;
+
+    Node errorNode = Node();  // The last error(), which skip() adds to
+    bool recovering = false;  // No token shifted since the last recovery
+    bool recoveredAtEnd = false;
+};
+
+template <typename Tables, typename Lexer, typename NodeBuilder>
+class LRDriver {
+public:
+    using Token = typename Lexer::Token;
+    using Node = typename NodeBuilder::Node;
+
+    LRDriver(Lexer &lexer, NodeBuilder &builder) : lexer(lexer), automaton(builder) {}
+
+    // Counters are added to profile, which must have room for every state
+    // and rule of Tables. Ignored unless SCRIPT_PROFILING is set.
+    void setProfile(ParseProfile *profile) {
+        this->profile = profile;
+        automaton.setProfile(profile);
+    }
+
+    // With Trace set, every action is printed to stdout. Throws
+    // LRSyntaxError on a syntax error, after which the last token the lexer
+    // returned is the offending one.
+    template <bool Trace = false>
+    Node parse() {
+        automaton.reset();
+#if SCRIPT_PROFILING
+        uint64_t start = readCycleCounter();
+        uint64_t outsideLoop = profile ? profile->lexCycles + profile->nodeCycles : 0;
+#endif
+        while (true) {
+            Token token = nextToken();
+            if (automaton.template push<Trace>(token, Lexer::terminal(token))) {
+                break;
+            }
+        }
+#if SCRIPT_PROFILING
+        if (profile) {
+            uint64_t inside = profile->lexCycles + profile->nodeCycles - outsideLoop;
+            profile->parseCycles += readCycleCounter() - start - inside;
+        }
+#endif
+        return automaton.result();
+    }
+
+private:
+    Token nextToken() {
+#if SCRIPT_PROFILING
+        if (profile) {
+            uint64_t start = readCycleCounter();
+            Token token = lexer.next();
+            profile->lexCycles += readCycleCounter() - start;
+            return token;
+        }
+#endif
+        return lexer.next();
+    }
+
+    Lexer &lexer;
+    LRAutomaton<Tables, NodeBuilder> automaton;
+    ParseProfile *profile = nullptr;
+};
+
+// Lexer over tokens that were already lexed into a vector. Once the vector
+// is exhausted it keeps returning endOfFile.
+template <typename T, int (*TerminalOf)(const T &)>
+class VectorLexer {
+public:
+    using Token = T;
+
+    VectorLexer(const std::vector<T> &tokens, T endOfFile) : tokens(tokens), endOfFile(endOfFile) {}
+
+    Token next() { return index < tokens.size() ? tokens[index++] : endOfFile; }
+    static int terminal(const Token &token) { return TerminalOf(token); }
+
+    // Index of the next token in the vector
+    size_t position() const { return index; }
+
+private:
+    const std::vector<T> &tokens;
+    T endOfFile;
+    size_t index = 0;
+};
+
+// Builds the generic CST of a generated cst.h: terminals are the lexer's own
+// nodes and every reduction creates a node of its left-hand side
+template <typename CSTNode, typename CSTNodeType>
+class CSTBuilder {
+public:
+    using Node = CSTNode *;
+
+    Node shift(Node token) { return token; }
+    Node reduce(int, int lhs, std::span<Node> children) {
+        Node parent = new CSTNode((CSTNodeType)lhs);
+        parent->children.reserve(children.size());
+        for (Node child : children) {
+            parent->addChild(child);
+        }
+        return parent;
+    }
+};
+
+// CSTBuilder that keeps its nodes: release() takes them all back without
+// freeing them, and a reused node keeps the capacity of its children, so a
+// builder that has seen an input as large as the next builds it without
+// allocating
+template <typename CSTNode, typename CSTNodeType>
+class PooledCSTBuilder {
+public:
+    using Node = CSTNode *;
+
+    Node shift(Node token) { return token; }
+    Node reduce(int, int lhs, std::span<Node> children) {
+        if (used == nodes.size()) {
+            nodes.push_back(std::make_unique<CSTNode>((CSTNodeType)lhs));
+        }
+        Node parent = nodes[used++].get();
+        parent->type = (CSTNodeType)lhs;
+        parent->children.clear();
+        for (Node child : children) {
+            parent->addChild(child);
+        }
+        return parent;
+    }
+
+    // Every node built so far becomes free for reuse
+    void release() { used = 0; }
+
+private:
+    std::vector<std::unique_ptr<CSTNode>> nodes;
+    size_t used = 0;
+};
+
+// Forwards shifts and reductions to user callbacks, SAX style. The value
+// stack holds whatever type the callbacks return.
+template <typename Token, typename Value, typename OnShift, typename OnReduce>
+class CallbackBuilder {
+public:
+    using Node = Value;
+
+    CallbackBuilder(OnShift onShift, OnReduce onReduce) : onShift(onShift), onReduce(onReduce) {}
+
+    Node shift(const Token &token) { return onShift(token); }
+    Node reduce(int rule, int, std::span<Node> children) { return onReduce(rule, children); }
+
+private:
+    OnShift onShift;
+    OnReduce onReduce;
+};
+
+// Builds nothing, for callers that only need to know whether input parses
+template <typename Token>
+class RecognizerBuilder {
+public:
+    struct Node {};
+
+    Node shift(const Token &) { return {}; }
+    Node reduce(int, int, std::span<Node>) { return {}; }
+};
+
+#endif // LR_DRIVER_H
@@ -0,0 +1,39 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Failed to open file: " + path);
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw runtime_error("Failed to stat file: " + path);
+    }
+    length = status.st_size;
+    if (length == 0) {
+        close(fd);  // mmap rejects empty files; an empty mapping is still valid
+        return;
+    }
+    address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        address = nullptr;
+        throw runtime_error("Failed to map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (address != nullptr) {
+        munmap(address, length);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    // Throws runtime_error if the file cannot be opened or mapped
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const char *data() const { return static_cast<const char *>(address); }
+    size_t size() const { return length; }
+
+    template <typename T>
+    const T *at(size_t offset) const { return reinterpret_cast<const T *>(data() + offset); }
+
+    // True if count elements of T starting at offset lie inside the file and
+    // offset is suitably aligned for T
+    template <typename T>
+    bool contains(size_t offset, size_t count) const {
+        return offset % alignof(T) == 0 && offset <= length && count <= (length - offset) / sizeof(T);
+    }
+
+private:
+    void *address = nullptr;
+    size_t length = 0;
+};
+
+#endif // MAPPED_FILE_H
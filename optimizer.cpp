@@ -0,0 +1,243 @@
+#include "optimizer.h"
+
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Identity of an expression for value numbering. Operands are compared by
+// value number, so two keys match exactly when the subtrees compute the same
+// thing.
+struct ValueKey {
+    ASTNodeKind kind;
+    BinaryOperator op;
+    int64_t a;
+    int64_t b;
+
+    bool operator==(const ValueKey &other) const {
+        return kind == other.kind && op == other.op && a == other.a && b == other.b;
+    }
+};
+
+struct ValueKeyHash {
+    size_t operator()(const ValueKey &key) const {
+        size_t h = (size_t)key.kind * 31 + (size_t)key.op;
+        h = h * 1000003 ^ hash<int64_t>()(key.a);
+        h = h * 1000003 ^ hash<int64_t>()(key.b);
+        return h;
+    }
+};
+
+// Optimizes one return expression. The value table is deliberately local to
+// a single expression; sharing across statements would buy nothing because
+// only the first return of a function is ever executed.
+class ExpressionOptimizer {
+public:
+    ExpressionOptimizer(Arena &arena, OptimizationStats &stats) : arena(arena), stats(stats) {}
+
+    // Walks the expression post-order with an explicit stack, since it nests
+    // one level per operator and a long one would overflow the call stack.
+    // Operands are optimized lhs first, which value numbering relies on to
+    // number nodes the same way every time.
+    ASTExpression *optimize(ASTExpression *root) {
+        struct Frame {
+            ASTExpression *expression;
+            bool expanded;  // Operands queued; their results are on top of values
+        };
+        vector<Frame> pending = {{root, false}};
+        vector<ASTExpression *> values;
+        while (!pending.empty()) {
+            Frame frame = pending.back();
+            ASTExpression *expression = frame.expression;
+            if (expression->kind == ASTNodeKind::BINARY_OP && !frame.expanded) {
+                stats.nodesBefore++;
+                auto *binaryOp = static_cast<ASTBinaryOp *>(expression);
+                pending.back().expanded = true;
+                pending.push_back({binaryOp->rhs, false});
+                pending.push_back({binaryOp->lhs, false});
+                continue;
+            }
+            pending.pop_back();
+
+            switch (expression->kind) {
+                case ASTNodeKind::INT_LITERAL:
+                    stats.nodesBefore++;
+                    values.push_back(literal(static_cast<ASTIntLiteral *>(expression)->value, expression));
+                    break;
+                case ASTNodeKind::VAR_REF: {
+                    stats.nodesBefore++;
+                    auto *varRef = static_cast<ASTVarRef *>(expression);
+                    values.push_back(intern({ASTNodeKind::VAR_REF, BinaryOperator::ADD, varRef->paramIndex, 0}, expression));
+                    break;
+                }
+                default: {
+                    ASTExpression *rhs = values.back();
+                    values.pop_back();
+                    ASTExpression *lhs = values.back();
+                    values.pop_back();
+                    values.push_back(simplify(static_cast<ASTBinaryOp *>(expression)->op, lhs, rhs));
+                    break;
+                }
+            }
+        }
+        return values.back();
+    }
+
+private:
+    ASTExpression *simplify(BinaryOperator op, ASTExpression *lhs, ASTExpression *rhs) {
+        bool lhsConstant = lhs->kind == ASTNodeKind::INT_LITERAL;
+        bool rhsConstant = rhs->kind == ASTNodeKind::INT_LITERAL;
+
+        if (lhsConstant && rhsConstant) {
+            stats.constantsFolded++;
+            return literal(applyBinaryOperator(op, valueOf(lhs), valueOf(rhs)));
+        }
+
+        // Keep constants on the right of commutative operators so the rules
+        // below only need to look in one place
+        if ((op == BinaryOperator::ADD || op == BinaryOperator::MULTIPLY) && lhsConstant) {
+            swap(lhs, rhs);
+            swap(lhsConstant, rhsConstant);
+        }
+
+        if (rhsConstant) {
+            int32_t c = valueOf(rhs);
+            if (c == 0 && (op == BinaryOperator::ADD || op == BinaryOperator::SUBTRACT)) {
+                stats.identitiesSimplified++;
+                return lhs;
+            }
+            if (c == 1 && (op == BinaryOperator::MULTIPLY || op == BinaryOperator::DIVIDE)) {
+                stats.identitiesSimplified++;
+                return lhs;
+            }
+            if (c == 0 && (op == BinaryOperator::MULTIPLY || op == BinaryOperator::DIVIDE)) {
+                // x / 0 is defined to be 0
+                stats.identitiesSimplified++;
+                return literal(0);
+            }
+            if (op == BinaryOperator::SUBTRACT) {
+                // x - c == x + (-c) under wrapping arithmetic; this lets the
+                // reassociation below merge mixed + and - chains
+                return simplify(BinaryOperator::ADD, lhs, literal(applyBinaryOperator(BinaryOperator::SUBTRACT, 0, c)));
+            }
+            if ((op == BinaryOperator::ADD || op == BinaryOperator::MULTIPLY) && lhs->kind == ASTNodeKind::BINARY_OP) {
+                // (x op c1) op c2 -> x op (c1 op c2); exact because both operators
+                // are associative modulo 2^32
+                auto *inner = static_cast<ASTBinaryOp *>(lhs);
+                if (inner->op == op && inner->rhs->kind == ASTNodeKind::INT_LITERAL) {
+                    stats.constantsFolded++;
+                    return simplify(op, inner->lhs, literal(applyBinaryOperator(op, valueOf(inner->rhs), c)));
+                }
+            }
+            if (c == 2 && op == BinaryOperator::MULTIPLY) {
+                stats.strengthReductions++;
+                return simplify(BinaryOperator::ADD, lhs, lhs);
+            }
+        }
+
+        if (lhsConstant && valueOf(lhs) == 0 && op == BinaryOperator::DIVIDE) {
+            stats.identitiesSimplified++;
+            return literal(0);
+        }
+        if (lhs == rhs && op == BinaryOperator::SUBTRACT) {
+            stats.identitiesSimplified++;
+            return literal(0);
+        }
+
+        if ((op == BinaryOperator::ADD || op == BinaryOperator::MULTIPLY) && !rhsConstant &&
+            valueNumber(lhs) > valueNumber(rhs)) {
+            swap(lhs, rhs);
+        }
+        ValueKey key = {ASTNodeKind::BINARY_OP, op, valueNumber(lhs), valueNumber(rhs)};
+        auto iter = valueTable.find(key);
+        if (iter != valueTable.end()) {
+            stats.commonSubexpressions++;
+            return iter->second;
+        }
+        auto *binaryOp = arena.make<ASTBinaryOp>();
+        binaryOp->kind = ASTNodeKind::BINARY_OP;
+        binaryOp->op = op;
+        binaryOp->lhs = lhs;
+        binaryOp->rhs = rhs;
+        return intern(key, binaryOp);
+    }
+
+    static int32_t valueOf(const ASTExpression *expression) {
+        return static_cast<const ASTIntLiteral *>(expression)->value;
+    }
+
+    int64_t valueNumber(const ASTExpression *expression) const {
+        return valueNumbers.at(expression);
+    }
+
+    ASTExpression *literal(int32_t value, ASTExpression *existing = nullptr) {
+        ValueKey key = {ASTNodeKind::INT_LITERAL, BinaryOperator::ADD, value, 0};
+        auto iter = valueTable.find(key);
+        if (iter != valueTable.end()) {
+            return iter->second;
+        }
+        if (existing == nullptr) {
+            auto *node = arena.make<ASTIntLiteral>();
+            node->kind = ASTNodeKind::INT_LITERAL;
+            node->value = value;
+            existing = node;
+        }
+        return intern(key, existing);
+    }
+
+    // Returns the node already recorded for key, or records expression for it
+    ASTExpression *intern(const ValueKey &key, ASTExpression *expression) {
+        auto [iter, inserted] = valueTable.emplace(key, expression);
+        if (inserted) {
+            valueNumbers[expression] = valueNumbers.size();
+        }
+        return iter->second;
+    }
+
+    Arena &arena;
+    OptimizationStats &stats;
+    unordered_map<ValueKey, ASTExpression *, ValueKeyHash> valueTable;
+    unordered_map<const ASTExpression *, int64_t> valueNumbers;
+};
+
+uint32_t countDistinctNodes(const ASTExpression *root) {
+    unordered_set<const ASTExpression *> seen;
+    vector<const ASTExpression *> pending = {root};
+    while (!pending.empty()) {
+        const ASTExpression *expression = pending.back();
+        pending.pop_back();
+        if (!seen.insert(expression).second) {
+            continue;
+        }
+        if (expression->kind == ASTNodeKind::BINARY_OP) {
+            auto *binaryOp = static_cast<const ASTBinaryOp *>(expression);
+            pending.push_back(binaryOp->lhs);
+            pending.push_back(binaryOp->rhs);
+        }
+    }
+    return seen.size();
+}
+
+}  // namespace
+
+void optimizeProgram(ASTProgram *program, Arena &arena, OptimizationStats &stats) {
+    for (ASTFunction *function : program->functions) {
+        for (ASTReturn *statement : function->statements) {
+            ExpressionOptimizer optimizer(arena, stats);
+            statement->value = optimizer.optimize(statement->value);
+            stats.nodesAfter += countDistinctNodes(statement->value);
+        }
+    }
+}
+
+void printOptimizationStats(const OptimizationStats &stats) {
+    cout << "Expression nodes: " << stats.nodesBefore << " -> " << stats.nodesAfter << "\n";
+    cout << "Constants folded: " << stats.constantsFolded << "\n";
+    cout << "Identities simplified: " << stats.identitiesSimplified << "\n";
+    cout << "Strength reductions: " << stats.strengthReductions << "\n";
+    cout << "Common subexpressions: " << stats.commonSubexpressions << endl;
+}
@@ -0,0 +1,27 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <cstdint>
+
+#include "arena.h"
+#include "ast.h"
+
+struct OptimizationStats {
+    uint32_t nodesBefore = 0;  // Expression nodes before optimizing
+    uint32_t nodesAfter = 0;  // Distinct expression nodes afterwards
+    uint32_t constantsFolded = 0;  // BinaryOps evaluated at compile time, including reassociated ones
+    uint32_t identitiesSimplified = 0;  // x + 0, x * 1, x * 0, x - x, ...
+    uint32_t strengthReductions = 0;  // x * 2 -> x + x
+    uint32_t commonSubexpressions = 0;  // BinaryOps replaced by an earlier identical one
+};
+
+// Simplifies every return expression of program in place. Constant subtrees
+// are folded with the script's wrapping and division-by-zero semantics,
+// algebraic identities and strength reductions are applied, and identical
+// subexpressions within one return expression are value-numbered into a
+// single shared node, so the result is a DAG rather than a tree.
+void optimizeProgram(ASTProgram *program, Arena &arena, OptimizationStats &stats);
+
+void printOptimizationStats(const OptimizationStats &stats);
+
+#endif // OPTIMIZER_H
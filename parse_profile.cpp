@@ -0,0 +1,87 @@
+#include "parse_profile.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+using namespace std;
+
+// Indices of counts in descending order of count, zero counts left out
+static vector<size_t> sortedByCount(const vector<uint64_t> &counts) {
+    vector<size_t> order;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] != 0) {
+            order.push_back(i);
+        }
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return counts[a] > counts[b]; });
+    return order;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * part / whole;
+}
+
+void printParseProfile(const ParseProfile &profile, span<const char *const> ruleText, ostream &out) {
+    uint64_t totalCycles = profile.lexCycles + profile.parseCycles + profile.nodeCycles;
+    out << fixed << setprecision(1);
+    out << "Phases (cycles):" << endl;
+    out << "  lexing            " << setw(14) << profile.lexCycles << "  " << setw(5) << percent(profile.lexCycles, totalCycles) << "%" << endl;
+    out << "  parse loop        " << setw(14) << profile.parseCycles << "  " << setw(5) << percent(profile.parseCycles, totalCycles) << "%" << endl;
+    out << "  node allocation   " << setw(14) << profile.nodeCycles << "  " << setw(5) << percent(profile.nodeCycles, totalCycles) << "%" << endl;
+
+    out << "Shifts: " << profile.shifts << ", reductions: " << profile.reductions << ", shift/reduce ratio: "
+        << setprecision(2) << (profile.reductions == 0 ? 0.0 : (double)profile.shifts / profile.reductions) << endl;
+    out << "Maximum stack depth: " << profile.maxStackDepth << endl;
+    out << setprecision(1);
+
+    uint64_t totalVisits = accumulate(profile.stateVisits.begin(), profile.stateVisits.end(), uint64_t(0));
+    out << "State visits:" << endl;
+    for (size_t state : sortedByCount(profile.stateVisits)) {
+        out << "  state " << setw(5) << state << "  " << setw(12) << profile.stateVisits[state] << "  " << setw(5)
+            << percent(profile.stateVisits[state], totalVisits) << "%" << endl;
+    }
+
+    out << "Rule reductions:" << endl;
+    for (size_t rule : sortedByCount(profile.ruleReductions)) {
+        out << "  rule " << setw(4) << rule << "  " << setw(12) << profile.ruleReductions[rule] << "  " << setw(5)
+            << percent(profile.ruleReductions[rule], profile.reductions) << "%  "
+            << (rule < ruleText.size() ? ruleText[rule] : "") << endl;
+    }
+}
+
+template <typename T>
+static void writeArray(span<const T> values, ostream &out) {
+    out << "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        out << (i ? "," : "") << values[i];
+    }
+    out << "]";
+}
+
+void writeParseProfileJSON(const ParseProfile &profile, span<const char *const> ruleText,
+                           span<const uint16_t> generatorStates, ostream &out) {
+    out << "{\"cycles\":{\"lexing\":" << profile.lexCycles << ",\"parseLoop\":" << profile.parseCycles
+        << ",\"nodeAllocation\":" << profile.nodeCycles << "},";
+    out << "\"shifts\":" << profile.shifts << ",\"reductions\":" << profile.reductions << ",";
+    out << "\"maxStackDepth\":" << profile.maxStackDepth << ",";
+    out << "\"stateVisits\":";
+    writeArray(span<const uint64_t>(profile.stateVisits), out);
+    out << ",\"generatorStates\":";
+    writeArray(generatorStates, out);
+    out << ",\"ruleReductions\":";
+    writeArray(span<const uint64_t>(profile.ruleReductions), out);
+    out << ",\"rules\":[";
+    for (size_t i = 0; i < ruleText.size(); ++i) {
+        out << (i ? "," : "") << "\"";
+        // Rule text is grammar symbols and spaces, but escape anyway
+        for (const char *c = ruleText[i]; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << "\"";
+    }
+    out << "]}" << endl;
+}
@@ -0,0 +1,55 @@
+#ifndef PARSE_PROFILE_H
+#define PARSE_PROFILE_H
+
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Instrumentation of the LR driver is compiled in only when SCRIPT_PROFILING
+// is set (cmake -DSCRIPT_PROFILING=ON). Otherwise the driver's hot loop
+// contains no profiling code at all.
+#ifndef SCRIPT_PROFILING
+#define SCRIPT_PROFILING 0
+#endif
+
+// Time stamp counter where there is one, nanoseconds elsewhere
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Counters filled by an instrumented LRDriver, accumulated over any number
+// of parses
+struct ParseProfile {
+    std::vector<uint64_t> stateVisits;  // Parse loop iterations per state
+    std::vector<uint64_t> ruleReductions;
+    uint64_t shifts = 0;
+    uint64_t reductions = 0;
+    size_t maxStackDepth = 0;
+    uint64_t lexCycles = 0;  // Inside the lexer, or tokenize() when measured by the caller
+    uint64_t parseCycles = 0;  // The parse loop itself, excluding the other two
+    uint64_t nodeCycles = 0;  // Inside the node builder: allocating and linking nodes
+
+    ParseProfile(size_t stateCount, size_t ruleCount) : stateVisits(stateCount), ruleReductions(ruleCount) {}
+};
+
+// Human-readable report with states and rules sorted by count
+void printParseProfile(const ParseProfile &profile, std::span<const char *const> ruleText, std::ostream &out);
+
+// generatorStates is the generator's number of each state
+// (ParserTables::generatorStates); parser_generator --profile reads it to
+// match counts to states even after it has renumbered them.
+void writeParseProfileJSON(const ParseProfile &profile, std::span<const char *const> ruleText,
+                           std::span<const uint16_t> generatorStates, std::ostream &out);
+
+#endif // PARSE_PROFILE_H
@@ -0,0 +1,459 @@
+#include "parse_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "bytecode.h"
+#include "diagnostics.h"
+#include "optimizer.h"
+#include "program_image.h"
+#include "script_parser.h"
+#include "symbol_table.h"
+
+using namespace std;
+
+static uint64_t nowMicroseconds() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool writeFully(int fd, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+template <typename T>
+static void appendBytes(vector<char> &out, const T &value) {
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Deepest nesting of expression, term and factor nodes under any statement
+static size_t expressionDepth(const CSTNode *root) {
+    size_t deepest = 0;
+    vector<pair<const CSTNode *, size_t>> pending = {{root, 0}};
+    while (!pending.empty()) {
+        auto [node, depth] = pending.back();
+        pending.pop_back();
+        if (node->type == CSTNodeType::EXPRESSION || node->type == CSTNodeType::TERM ||
+            node->type == CSTNodeType::FACTOR) {
+            deepest = max(deepest, ++depth);
+        }
+        for (const CSTNode *child : node->children) {
+            pending.push_back({child, depth});
+        }
+    }
+    return deepest;
+}
+
+void serializeCST(const CSTNode *root, vector<char> &out) {
+    vector<const CSTNode *> pending = {root};
+    while (!pending.empty()) {
+        const CSTNode *node = pending.back();
+        pending.pop_back();
+        CSTRecord record = {};
+        string_view value;
+        char buffer[24];
+        if (node->type == CSTNodeType::TERMINAL) {
+            const CSTTerminalNode *terminal = static_cast<const CSTTerminalNode *>(node);
+            record.type = terminal->type;
+            record.terminal = 1;
+            value = terminal->spelling(buffer);
+        } else {
+            record.type = node->type;
+        }
+        record.childCount = node->children.size();
+        record.valueLength = value.size();
+        appendBytes(out, record);
+        out.insert(out.end(), value.begin(), value.end());
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            pending.push_back(*child);
+        }
+    }
+}
+
+ParseServer::ParseServer(const string &socketPath, size_t workerCount)
+    : socketPath(socketPath), workers(max(workerCount, size_t(1))) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Socket path is too long: " + socketPath);
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    if (pipe(wakeFds) != 0) {
+        throw runtime_error("Failed to create a pipe: " + string(strerror(errno)));
+    }
+    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(socketPath.c_str());
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        string reason = strerror(errno);
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+        close(wakeFds[0]);
+        close(wakeFds[1]);
+        throw runtime_error("Failed to listen on " + socketPath + ": " + reason);
+    }
+    latencies.reserve(LATENCY_SAMPLES);
+}
+
+ParseServer::~ParseServer() {
+    stop();
+    {
+        lock_guard<mutex> lock(queueMutex);
+        ready.notify_all();
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    for (const Request &request : pending) {
+        close(request.connection.fd);
+    }
+    for (const Connection &connection : returned) {
+        close(connection.fd);
+    }
+    close(listenFd);
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    unlink(socketPath.c_str());
+}
+
+void ParseServer::stop() {
+    stopping = true;
+    char wake = 0;
+    (void)!write(wakeFds[1], &wake, 1);
+}
+
+// Reads whatever has arrived of the connection's current request without
+// blocking. A request is complete once its body is, or right after its
+// length for a stats request or one too large to read.
+ParseServer::ReadResult ParseServer::readRequest(Connection &connection) {
+    size_t &received = connection.received;
+    uint32_t &length = connection.length;
+    string &body = connection.body;
+    while (true) {
+        char *into;
+        size_t wanted;
+        if (received < sizeof(length)) {
+            into = connection.lengthBytes + received;
+            wanted = sizeof(length) - received;
+        } else {
+            size_t bodyReceived = received - sizeof(length);
+            if (bodyReceived == body.size()) {
+                return ReadResult::COMPLETE;
+            }
+            into = body.data() + bodyReceived;
+            wanted = body.size() - bodyReceived;
+        }
+
+        ssize_t n = recv(connection.fd, into, wanted, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return ReadResult::PARTIAL;
+        }
+        if (n <= 0) {
+            return ReadResult::CLOSED;
+        }
+        received += n;
+        if (received == sizeof(length)) {
+            memcpy(&length, connection.lengthBytes, sizeof(length));
+            if (length == PARSE_SERVER_STATS_REQUEST || length > PARSE_SERVER_MAX_REQUEST) {
+                body.clear();
+                return ReadResult::COMPLETE;
+            }
+            try {
+                body.resize(length);
+            } catch (const bad_alloc &) {
+                return ReadResult::CLOSED;  // No memory to take the request in
+            }
+        }
+    }
+}
+
+void ParseServer::run() {
+    for (Worker &worker : workers) {
+        threads.emplace_back([this, &worker] { work(worker); });
+    }
+
+    // Connections waiting for or reading their next request. A connection is
+    // watched here or owned by a worker, never both.
+    vector<Connection> idle;
+    vector<pollfd> fds;
+    while (!stopping) {
+        fds.clear();
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        uint64_t nextDeadline = UINT64_MAX;
+        for (const Connection &connection : idle) {
+            fds.push_back({connection.fd, POLLIN, 0});
+            if (connection.received > 0) {
+                nextDeadline = min(nextDeadline, connection.deadline);
+            }
+        }
+        int timeout = -1;
+        if (nextDeadline != UINT64_MAX) {
+            uint64_t now = nowMicroseconds();
+            timeout = nextDeadline <= now ? 0 : (int)min<uint64_t>((nextDeadline - now + 999) / 1000, INT32_MAX);
+        }
+        if (poll(fds.data(), fds.size(), timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("poll failed: " + string(strerror(errno)));
+        }
+        uint64_t now = nowMicroseconds();
+
+        if (fds[0].revents) {
+            char drain[64];
+            while (read(wakeFds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0) {
+                // Reads never block, but a client that stops reading its
+                // responses would hold a worker without a send timeout
+                timeval sendTimeout = {PARSE_SERVER_TIMEOUT_MS / 1000, PARSE_SERVER_TIMEOUT_MS % 1000 * 1000};
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+                idle.emplace_back(client);
+            }
+        }
+
+        // Connections accepted after the poll are not in fds yet
+        vector<Connection> stillIdle;
+        vector<Request> complete;
+        for (size_t i = 0; i < idle.size(); ++i) {
+            Connection &connection = idle[i];
+            if (i + 2 < fds.size() && fds[i + 2].revents) {
+                bool started = connection.received > 0;
+                ReadResult result = readRequest(connection);
+                if (!started && connection.received > 0) {
+                    connection.deadline = now + PARSE_SERVER_TIMEOUT_MS * 1000ull;
+                }
+                if (result == ReadResult::CLOSED) {
+                    close(connection.fd);
+                    continue;
+                }
+                if (result == ReadResult::COMPLETE) {
+                    complete.push_back({move(connection), now});
+                    continue;
+                }
+            }
+            if (connection.received > 0 && now >= connection.deadline) {
+                close(connection.fd);  // Timed out partway through a request
+                continue;
+            }
+            stillIdle.push_back(move(connection));
+        }
+
+        {
+            lock_guard<mutex> lock(queueMutex);
+            for (Request &request : complete) {
+                pending.push_back(move(request));
+            }
+            for (Connection &connection : returned) {
+                stillIdle.push_back(move(connection));
+            }
+            returned.clear();
+            if (!pending.empty()) {
+                ready.notify_all();
+            }
+        }
+        idle = move(stillIdle);
+    }
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        ready.notify_all();
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    threads.clear();
+    for (const Connection &connection : idle) {
+        close(connection.fd);
+    }
+}
+
+void ParseServer::work(Worker &worker) {
+    vector<Request> batch;
+    while (true) {
+        batch.clear();
+        {
+            unique_lock<mutex> lock(queueMutex);
+            ++idleWorkers;
+            ready.wait(lock, [this] { return stopping || !pending.empty(); });
+            // This worker's share of the queue among the idle workers, this
+            // one included, so one worker never sits on requests the others
+            // could be serving
+            size_t share = (pending.size() + idleWorkers - 1) / idleWorkers;
+            --idleWorkers;
+            if (stopping) {
+                return;
+            }
+            while (!pending.empty() && batch.size() < min(share, PARSE_SERVER_BATCH)) {
+                batch.push_back(move(pending.front()));
+                pending.pop_front();
+            }
+        }
+
+        vector<Connection> keep;
+        for (Request &request : batch) {
+            bool answered;
+            try {
+                answered = serve(worker, request);
+            } catch (const exception &) {
+                answered = false;  // Failed outside the parse, so there is no answer to give
+            }
+            if (answered) {
+                Connection &connection = request.connection;
+                connection.received = 0;
+                connection.length = 0;
+                keep.push_back(move(connection));
+            } else {
+                close(request.connection.fd);
+            }
+        }
+        if (!keep.empty()) {
+            lock_guard<mutex> lock(queueMutex);
+            for (Connection &connection : keep) {
+                returned.push_back(move(connection));
+            }
+        }
+        char wake = 0;
+        (void)!write(wakeFds[1], &wake, 1);
+    }
+}
+
+// Answers one complete request. Returns false once the connection should be
+// closed.
+bool ParseServer::serve(Worker &worker, Request &request) {
+    int fd = request.connection.fd;
+    uint32_t length = request.connection.length;
+    vector<char> &out = worker.output;
+    out.assign(sizeof(ParseResponseHeader), 0);
+    ParseResponseHeader header = {};
+    string diagnostics;
+
+    if (length == PARSE_SERVER_STATS_REQUEST) {
+        LatencyStats stats = latency();
+        diagnostics = "requests " + to_string(stats.requests) + "\np50_us " + to_string(stats.p50Microseconds) +
+                      "\np99_us " + to_string(stats.p99Microseconds) + "\n";
+    } else if (length > PARSE_SERVER_MAX_REQUEST) {
+        header.status = PARSE_RESPONSE_ERROR;
+        diagnostics = "Request of " + to_string(length) + " bytes is too large\n";
+        out.insert(out.end(), diagnostics.begin(), diagnostics.end());
+        header.diagnosticsSize = diagnostics.size();
+        header.length = out.size() - sizeof(header.length);
+        memcpy(out.data(), &header, sizeof(header));
+        writeFully(fd, out.data(), out.size());
+        return false;  // The rest of the stream cannot be trusted
+    } else {
+        const string &source = request.connection.body;
+        ScriptParser &parser = *worker.parser;
+        try {
+            CSTNode *cstRoot = parser.parse(source);
+            size_t depth = expressionDepth(cstRoot);
+            if (depth > PARSE_SERVER_MAX_EXPRESSION_DEPTH) {
+                throw runtime_error("Expression nesting of " + to_string(depth) + " exceeds the limit of " +
+                                    to_string(PARSE_SERVER_MAX_EXPRESSION_DEPTH));
+            }
+            serializeCST(cstRoot, out);
+            header.cstSize = out.size() - sizeof(header);
+
+            ASTProgram *astRoot = parser.lower();
+            OptimizationStats optimizationStats;
+            optimizeProgram(astRoot, parser.arena(), optimizationStats);
+            BytecodeProgram program = compileProgram(astRoot, parser.symbols());
+            vector<char> image = buildProgramImage(hashSource(source), astRoot, &program, parser.symbols());
+            out.insert(out.end(), image.begin(), image.end());
+            header.astSize = image.size();
+        } catch (const exception &e) {
+            // Anything a request makes throw, even bad_alloc on a huge one,
+            // is answered as its error, so the worker and daemon live on.
+            // Buffers grown by a request that ran out of memory are freed
+            if (dynamic_cast<const bad_alloc *>(&e)) {
+                worker.parser.reset();
+                worker.parser = make_unique<ScriptParser>();
+                vector<char>().swap(out);
+            }
+            header.status = PARSE_RESPONSE_ERROR;
+            out.resize(sizeof(header));
+            header.cstSize = 0;
+            header.astSize = 0;
+            const SyntaxError *syntaxError = dynamic_cast<const SyntaxError *>(&e);
+            diagnostics = (syntaxError ? LineIndex(source).describe(*syntaxError) : string(e.what())) + "\n";
+        }
+    }
+
+    out.insert(out.end(), diagnostics.begin(), diagnostics.end());
+    header.diagnosticsSize = diagnostics.size();
+    header.length = out.size() - sizeof(header.length);
+    memcpy(out.data(), &header, sizeof(header));
+    bool written = writeFully(fd, out.data(), out.size());
+    if (length != PARSE_SERVER_STATS_REQUEST) {
+        recordLatency(nowMicroseconds() - request.readyTime);
+    }
+    return written;
+}
+
+void ParseServer::recordLatency(uint64_t microseconds) {
+    lock_guard<mutex> lock(latencyMutex);
+    uint32_t sample = min<uint64_t>(microseconds, UINT32_MAX);
+    if (latencies.size() < LATENCY_SAMPLES) {
+        latencies.push_back(sample);
+    } else {
+        latencies[requestCount % LATENCY_SAMPLES] = sample;
+    }
+    ++requestCount;
+}
+
+LatencyStats ParseServer::latency() const {
+    vector<uint32_t> samples;
+    LatencyStats stats = {};
+    {
+        lock_guard<mutex> lock(latencyMutex);
+        samples = latencies;
+        stats.requests = requestCount;
+    }
+    if (samples.empty()) {
+        return stats;
+    }
+    auto percentile = [&](size_t percent) {
+        auto nth = samples.begin() + (samples.size() - 1) * percent / 100;
+        nth_element(samples.begin(), nth, samples.end());
+        return *nth;
+    };
+    stats.p50Microseconds = percentile(50);
+    stats.p99Microseconds = percentile(99);
+    return stats;
+}
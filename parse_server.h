@@ -0,0 +1,152 @@
+#ifndef PARSE_SERVER_H
+#define PARSE_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cst.h"
+#include "script_parser.h"
+
+// Long-running parse service on a Unix domain socket, for callers that would
+// otherwise start a parser process per script.
+//
+// Every message is framed by a little-endian uint32_t length. A request is
+// the length followed by that many bytes of script source; a client may send
+// any number of requests on one connection and gets one response per
+// request, in order. The length PARSE_SERVER_STATS_REQUEST, with no body,
+// asks for the latency counters instead.
+//
+// A response is a ParseResponseHeader followed by three sections:
+//   CST          nodes in pre-order, each a CSTRecord followed by its value
+//   AST          the optimized AST and bytecode as a program image
+//                (program_image.h), empty if parsing failed
+//   diagnostics  error messages, one per line
+//
+// A poll() loop reads requests without blocking and queues each one only
+// once it has arrived in full, so no worker ever waits on a client. A request
+// whose first bytes have arrived must be complete within
+// PARSE_SERVER_TIMEOUT_MS or the connection is closed, and a response that
+// cannot be written within the same time closes it too. Workers from a
+// fixed pool share the queue out evenly: each takes its share of the queued
+// requests among the idle workers, up to PARSE_SERVER_BATCH, and keeps its
+// ScriptParser and buffers across requests.
+//
+// Scripts whose expressions nest deeper than PARSE_SERVER_MAX_EXPRESSION_DEPTH
+// (one level per operator in a chain, three per pair of parentheses) get
+// PARSE_RESPONSE_ERROR without being lowered or compiled.
+
+static const uint32_t PARSE_SERVER_STATS_REQUEST = UINT32_MAX;
+static const uint32_t PARSE_SERVER_MAX_REQUEST = 64 << 20;
+static const size_t PARSE_SERVER_BATCH = 16;
+static const uint32_t PARSE_SERVER_TIMEOUT_MS = 10 * 1000;
+static const size_t PARSE_SERVER_MAX_EXPRESSION_DEPTH = 10000;
+
+enum ParseResponseStatus : uint32_t {
+    PARSE_RESPONSE_OK,
+    PARSE_RESPONSE_ERROR,  // Diagnostics say why; CST and AST are empty
+};
+
+struct ParseResponseHeader {
+    uint32_t length;  // Of everything after this field
+    uint32_t status;
+    uint32_t cstSize;
+    uint32_t astSize;
+    uint32_t diagnosticsSize;
+};
+
+struct CSTRecord {
+    uint16_t type;  // CSTNodeType, or CSTTerminalNodeType for terminals
+    uint16_t terminal;  // 1 for terminals
+    uint32_t childCount;  // The children follow as the next subtrees
+    uint32_t valueLength;  // Bytes of terminal text after the record
+};
+
+// Latency from a request having arrived in full to its response being written
+struct LatencyStats {
+    uint64_t requests;
+    uint64_t p50Microseconds;
+    uint64_t p99Microseconds;
+};
+
+class ParseServer {
+public:
+    // Binds and listens on socketPath, replacing a stale socket file. Throws
+    // runtime_error if the socket cannot be set up.
+    ParseServer(const std::string &socketPath, size_t workerCount);
+    ~ParseServer();
+
+    ParseServer(const ParseServer &) = delete;
+    ParseServer &operator=(const ParseServer &) = delete;
+
+    // Serves until stop() is called
+    void run();
+
+    // Safe to call from a signal handler
+    void stop();
+
+    LatencyStats latency() const;
+
+private:
+    // A client connection, between requests or partway through reading one
+    struct Connection {
+        int fd;
+        char lengthBytes[sizeof(uint32_t)];
+        size_t received = 0;  // Bytes of the current request so far, its length included
+        uint32_t length = 0;  // Once received
+        std::string body;  // Keeps its capacity from one request to the next
+        uint64_t deadline = 0;  // Microseconds, steady clock; the request must be complete by then
+
+        explicit Connection(int fd) : fd(fd) {}
+    };
+
+    struct Request {
+        Connection connection;  // Holding a complete request
+        uint64_t readyTime;  // Microseconds, steady clock
+    };
+
+    enum class ReadResult { PARTIAL, COMPLETE, CLOSED };
+
+    static ReadResult readRequest(Connection &connection);
+
+    // Buffers kept across requests
+    struct Worker {
+        std::unique_ptr<ScriptParser> parser = std::make_unique<ScriptParser>();  // Replaced to free its buffers
+        std::vector<char> output;
+    };
+
+    void work(Worker &worker);
+    bool serve(Worker &worker, Request &request);
+    void recordLatency(uint64_t microseconds);
+
+    std::string socketPath;
+    int listenFd = -1;
+    int wakeFds[2] = {-1, -1};  // Written by stop() and by workers returning connections
+    std::atomic<bool> stopping = false;
+
+    std::mutex queueMutex;
+    std::condition_variable ready;
+    std::deque<Request> pending;
+    std::vector<Connection> returned;  // Connections to watch again after their request
+    size_t idleWorkers = 0;
+
+    std::vector<std::thread> threads;
+    std::vector<Worker> workers;
+
+    // The most recent LATENCY_SAMPLES latencies, as a ring
+    static constexpr size_t LATENCY_SAMPLES = 1 << 16;
+    mutable std::mutex latencyMutex;
+    std::vector<uint32_t> latencies;
+    uint64_t requestCount = 0;
+};
+
+// Appends root in the CST section format
+void serializeCST(const CSTNode *root, std::vector<char> &out);
+
+#endif // PARSE_SERVER_H
@@ -0,0 +1,312 @@
+#include "parse_tables.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+uint32_t appendSection(vector<char> &bytes, const vector<T> &items) {
+    bytes.resize((bytes.size() + 7) & ~size_t(7));
+    uint32_t offset = bytes.size();
+    const char *data = reinterpret_cast<const char *>(items.data());
+    bytes.insert(bytes.end(), data, data + items.size() * sizeof(T));
+    return offset;
+}
+
+// The reduction that fills most of a row, or PARSE_ERROR if it has none
+uint16_t defaultAction(const vector<uint16_t> &row) {
+    map<uint16_t, uint32_t> reduceCounts;
+    for (uint16_t action : row) {
+        if (parseActionKind(action) == PARSE_REDUCE) {
+            ++reduceCounts[action];
+        }
+    }
+    uint16_t best = encodeParseAction(PARSE_ERROR, 0);
+    uint32_t bestCount = 0;
+    for (auto [action, count] : reduceCounts) {
+        if (count > bestCount) {
+            best = action;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+}  // namespace
+
+void writeParseTables(const string &path, const ParseTableSource &source) {
+    if (source.actions.size() > PARSE_ACTION_MAX_TARGET || source.rules.size() > PARSE_ACTION_MAX_TARGET) {
+        throw runtime_error("Grammar has too many states or rules for binary parse tables");
+    }
+
+    vector<TableString> strings;
+    vector<char> stringBytes;
+    for (const vector<string> *names : {&source.terminals, &source.nonTerminals}) {
+        for (const string &name : *names) {
+            strings.push_back({(uint32_t)stringBytes.size(), (uint32_t)name.size()});
+            stringBytes.insert(stringBytes.end(), name.begin(), name.end());
+        }
+    }
+
+    vector<TableState> states;
+    vector<TableEntry> actions;
+    vector<TableEntry> gotos;
+    for (size_t state = 0; state < source.actions.size(); ++state) {
+        TableState row = {};
+        row.defaultAction = defaultAction(source.actions[state]);
+        row.actionsIndex = actions.size();
+        for (size_t terminal = 0; terminal < source.actions[state].size(); ++terminal) {
+            uint16_t action = source.actions[state][terminal];
+            if (parseActionKind(action) != PARSE_ERROR && action != row.defaultAction) {
+                actions.push_back({(uint16_t)terminal, action});
+            }
+        }
+        row.actionCount = actions.size() - row.actionsIndex;
+        row.gotosIndex = gotos.size();
+        for (size_t nonTerminal = 0; nonTerminal < source.gotos[state].size(); ++nonTerminal) {
+            if (source.gotos[state][nonTerminal] >= 0) {
+                gotos.push_back({(uint16_t)nonTerminal, (uint16_t)source.gotos[state][nonTerminal]});
+            }
+        }
+        row.gotoCount = gotos.size() - row.gotosIndex;
+        states.push_back(row);
+    }
+
+    vector<TableRule> rules;
+    vector<uint16_t> rhsSymbols;
+    for (const ParseTableSource::Rule &rule : source.rules) {
+        rules.push_back({(uint16_t)rule.lhs, (uint16_t)rule.rhs.size(), (uint32_t)rhsSymbols.size()});
+        rhsSymbols.insert(rhsSymbols.end(), rule.rhs.begin(), rule.rhs.end());
+    }
+
+    vector<char> bytes(sizeof(ParseTablesHeader));
+    ParseTablesHeader header = {};
+    memcpy(header.magic, PARSE_TABLES_MAGIC, sizeof(header.magic));
+    header.version = PARSE_TABLES_VERSION;
+    header.terminalCount = source.terminals.size();
+    header.nonTerminalCount = source.nonTerminals.size();
+    header.stateCount = states.size();
+    header.ruleCount = rules.size();
+    header.endOfFileTerminal = source.endOfFileTerminal;
+    header.stringsOffset = appendSection(bytes, strings);
+    header.stringBytesSize = stringBytes.size();
+    header.stringBytesOffset = appendSection(bytes, stringBytes);
+    header.statesOffset = appendSection(bytes, states);
+    header.actionCount = actions.size();
+    header.actionsOffset = appendSection(bytes, actions);
+    header.gotoCount = gotos.size();
+    header.gotosOffset = appendSection(bytes, gotos);
+    header.rulesOffset = appendSection(bytes, rules);
+    header.rhsSymbolCount = rhsSymbols.size();
+    header.rhsSymbolsOffset = appendSection(bytes, rhsSymbols);
+    header.fileSize = bytes.size();
+    memcpy(bytes.data(), &header, sizeof(header));
+
+    // Identical tables are left alone so their timestamp does not change
+    ifstream existing(path, ios::binary);
+    if (existing.is_open() && vector<char>(istreambuf_iterator<char>(existing), {}) == bytes) {
+        return;
+    }
+    existing.close();
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        throw runtime_error("Failed to open file: " + path);
+    }
+    file.write(bytes.data(), bytes.size());
+    if (!file) {
+        throw runtime_error("Failed to write file: " + path);
+    }
+}
+
+static bool validAction(uint16_t action, const ParseTablesHeader &h) {
+    switch (parseActionKind(action)) {
+        case PARSE_SHIFT:
+            return parseActionTarget(action) < h.stateCount;
+        case PARSE_REDUCE:
+            return parseActionTarget(action) < h.ruleCount;
+        default:
+            return true;
+    }
+}
+
+// Rows are searched with lower_bound, so their symbols must strictly increase
+static bool sortedBySymbol(span<const TableEntry> entries) {
+    return adjacent_find(entries.begin(), entries.end(), [](const TableEntry &entry, const TableEntry &next) {
+               return entry.symbol >= next.symbol;
+           }) == entries.end();
+}
+
+ParseTables::ParseTables(const string &path) : file(path) {
+    if (!file.contains<ParseTablesHeader>(0, 1)) {
+        throw runtime_error("Not a parse table file: " + path);
+    }
+
+    // Lookups trust every index and target, so check them all once here
+    const ParseTablesHeader &h = header();
+    uint32_t symbolCount = h.terminalCount + h.nonTerminalCount;
+    bool valid = memcmp(h.magic, PARSE_TABLES_MAGIC, sizeof(h.magic)) == 0 &&
+                 h.version == PARSE_TABLES_VERSION && h.fileSize == file.size() &&
+                 h.endOfFileTerminal < h.terminalCount && h.stateCount > 0 &&
+                 file.contains<TableString>(h.stringsOffset, symbolCount) &&
+                 file.contains<char>(h.stringBytesOffset, h.stringBytesSize) &&
+                 file.contains<TableState>(h.statesOffset, h.stateCount) &&
+                 file.contains<TableEntry>(h.actionsOffset, h.actionCount) &&
+                 file.contains<TableEntry>(h.gotosOffset, h.gotoCount) &&
+                 file.contains<TableRule>(h.rulesOffset, h.ruleCount) &&
+                 file.contains<uint16_t>(h.rhsSymbolsOffset, h.rhsSymbolCount);
+    for (uint32_t i = 0; valid && i < symbolCount; ++i) {
+        const TableString &s = section<TableString>(h.stringsOffset, symbolCount)[i];
+        valid = (uint64_t)s.offset + s.length <= h.stringBytesSize;
+    }
+    for (const TableState &state : valid ? states() : span<const TableState>()) {
+        valid = valid && (uint64_t)state.actionsIndex + state.actionCount <= h.actionCount &&
+                (uint64_t)state.gotosIndex + state.gotoCount <= h.gotoCount && validAction(state.defaultAction, h) &&
+                sortedBySymbol(actions().subspan(state.actionsIndex, state.actionCount)) &&
+                sortedBySymbol(gotos().subspan(state.gotosIndex, state.gotoCount));
+    }
+    for (const TableEntry &entry : valid ? actions() : span<const TableEntry>()) {
+        valid = valid && entry.symbol < h.terminalCount && validAction(entry.value, h);
+    }
+    for (const TableEntry &entry : valid ? gotos() : span<const TableEntry>()) {
+        valid = valid && entry.symbol < h.nonTerminalCount && entry.value < h.stateCount;
+    }
+    for (const TableRule &rule : valid ? rules() : span<const TableRule>()) {
+        valid = valid && rule.lhs < h.nonTerminalCount && (uint64_t)rule.rhsIndex + rule.length <= h.rhsSymbolCount;
+    }
+    for (uint16_t symbol : valid ? section<uint16_t>(h.rhsSymbolsOffset, h.rhsSymbolCount) : span<const uint16_t>()) {
+        valid = valid && symbol < symbolCount;
+    }
+    if (!valid) {
+        throw runtime_error("Not a valid parse table file: " + path);
+    }
+}
+
+string_view ParseTables::symbolName(uint32_t symbol) const {
+    const TableString &s = section<TableString>(header().stringsOffset, terminalCount() + nonTerminalCount())[symbol];
+    return {file.at<char>(header().stringBytesOffset + s.offset), s.length};
+}
+
+uint32_t ParseTables::findTerminal(string_view name) const {
+    for (uint32_t terminal = 0; terminal < terminalCount(); ++terminal) {
+        if (symbolName(terminal) == name) {
+            return terminal;
+        }
+    }
+    return UINT32_MAX;
+}
+
+uint16_t ParseTables::action(uint32_t state, uint32_t terminal) const {
+    const TableState &row = states()[state];
+    span<const TableEntry> entries = actions().subspan(row.actionsIndex, row.actionCount);
+    auto it = lower_bound(entries.begin(), entries.end(), terminal,
+                          [](const TableEntry &entry, uint32_t symbol) { return entry.symbol < symbol; });
+    return it != entries.end() && it->symbol == terminal ? it->value : row.defaultAction;
+}
+
+uint32_t ParseTables::gotoState(uint32_t state, uint32_t nonTerminal) const {
+    const TableState &row = states()[state];
+    span<const TableEntry> entries = gotos().subspan(row.gotosIndex, row.gotoCount);
+    auto it = lower_bound(entries.begin(), entries.end(), nonTerminal,
+                          [](const TableEntry &entry, uint32_t symbol) { return entry.symbol < symbol; });
+    return it != entries.end() && it->symbol == nonTerminal ? it->value : UINT32_MAX;
+}
+
+span<const uint16_t> ParseTables::ruleSymbols(uint32_t index) const {
+    const TableRule &r = rule(index);
+    return section<uint16_t>(header().rhsSymbolsOffset, header().rhsSymbolCount).subspan(r.rhsIndex, r.length);
+}
+
+TableParseNode *parseWithTables(const ParseTables &tables, span<const TableToken> tokens, Arena &arena) {
+    vector<uint32_t> stateStack = {0};
+    vector<TableParseNode *> nodeStack;
+    size_t index = 0;
+    // Reductions since the last shift. Valid tables reduce at most a few
+    // times per state on the stack before shifting again, while a file with a
+    // cycle of unit or empty rules would reduce forever without consuming a
+    // token, and with empty rules grow the stacks until memory runs out
+    uint64_t reductions = 0;
+    uint64_t reductionLimit = tables.stateCount();
+
+    while (true) {
+        uint32_t terminal = index < tokens.size() ? tokens[index].terminal : tables.endOfFileTerminal();
+        if (terminal >= tables.terminalCount()) {
+            throw runtime_error("Token " + to_string(index) + " is not a terminal of the grammar");
+        }
+        uint16_t action = tables.action(stateStack.back(), terminal);
+        switch (parseActionKind(action)) {
+            case PARSE_SHIFT: {
+                string_view text = index < tokens.size() ? tokens[index].text : string_view();
+                nodeStack.push_back(arena.make<TableParseNode>(terminal, text, span<TableParseNode *>()));
+                stateStack.push_back(parseActionTarget(action));
+                ++index;
+                reductions = 0;
+                reductionLimit = (uint64_t)stateStack.size() * tables.stateCount();
+                break;
+            }
+
+            case PARSE_REDUCE: {
+                if (++reductions > reductionLimit) {
+                    throw runtime_error("Parsing error: Reductions cycle without shifting at token " +
+                                        to_string(index) + ".");
+                }
+                const TableRule &rule = tables.rule(parseActionTarget(action));
+                // Valid tables never reduce more than is on the stack, but a
+                // file that merely passes validation might
+                if (nodeStack.size() < rule.length) {
+                    throw runtime_error("Parsing error: Reduction by rule " + to_string(parseActionTarget(action)) +
+                                        " needs more symbols than are on the stack.");
+                }
+                span<TableParseNode *> children = arena.makeArray<TableParseNode *>(rule.length);
+                copy(nodeStack.end() - rule.length, nodeStack.end(), children.begin());
+                nodeStack.resize(nodeStack.size() - rule.length);
+                stateStack.resize(stateStack.size() - rule.length);
+
+                uint32_t nextState = tables.gotoState(stateStack.back(), rule.lhs);
+                if (nextState == UINT32_MAX) {
+                    throw runtime_error("Parsing error: No goto available.");
+                }
+                uint32_t symbol = tables.terminalCount() + rule.lhs;
+                nodeStack.push_back(arena.make<TableParseNode>(symbol, string_view(), children));
+                stateStack.push_back(nextState);
+                break;
+            }
+
+            case PARSE_ACCEPT:
+                if (nodeStack.empty()) {
+                    throw runtime_error("Parsing error: Accepted before any symbol was parsed.");
+                }
+                return nodeStack.back();
+
+            default:
+                throw runtime_error("Parsing error: Unexpected " + string(tables.symbolName(terminal)) +
+                                    " at token " + to_string(index) + ".");
+        }
+    }
+}
+
+void printTableParseTree(const ParseTables &tables, const TableParseNode *root) {
+    vector<pair<const TableParseNode *, int>> pending = {{root, 0}};
+    while (!pending.empty()) {
+        auto [node, level] = pending.back();
+        pending.pop_back();
+        for (int i = 0; i < level; ++i) cout << "  ";
+        cout << tables.symbolName(node->symbol);
+        if (!node->text.empty()) {
+            cout << ": " << node->text;
+        }
+        cout << '\n';
+        for (size_t i = node->children.size(); i-- > 0;) {
+            pending.push_back({node->children[i], level + 1});
+        }
+    }
+    cout << flush;
+}
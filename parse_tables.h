@@ -0,0 +1,168 @@
+#ifndef PARSE_TABLES_H
+#define PARSE_TABLES_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "mapped_file.h"
+
+// Binary LR(1) parse tables that parser_generator can write and any program
+// can map and drive at runtime, so a new grammar needs no compile step.
+//
+// Layout: ParseTablesHeader, then the sections it points to, each aligned to
+// 8 bytes. Every reference is an index or a byte offset from the start of the
+// file. Symbols are numbered terminals first, then nonterminals, so symbol
+// terminalCount + n is nonterminal n.
+//
+// Both tables are stored as sorted sparse rows. A state's most common
+// reduction becomes its default action and is left out of its row, which
+// removes most of the entries of an LR(1) action table.
+
+static const char PARSE_TABLES_MAGIC[8] = {'S', 'C', 'R', 'I', 'P', 'T', 'P', 'T'};
+static const uint32_t PARSE_TABLES_VERSION = 1;
+
+enum ParseActionKind : uint16_t {
+    PARSE_ERROR,
+    PARSE_SHIFT,
+    PARSE_REDUCE,
+    PARSE_ACCEPT,
+};
+
+// Kind in the top two bits, target state or rule below
+static const uint32_t PARSE_ACTION_TARGET_BITS = 14;
+static const uint32_t PARSE_ACTION_MAX_TARGET = (1u << PARSE_ACTION_TARGET_BITS) - 1;
+
+inline uint16_t encodeParseAction(ParseActionKind kind, uint32_t target) {
+    return (uint16_t)(kind << PARSE_ACTION_TARGET_BITS | target);
+}
+inline ParseActionKind parseActionKind(uint16_t action) { return (ParseActionKind)(action >> PARSE_ACTION_TARGET_BITS); }
+inline uint32_t parseActionTarget(uint16_t action) { return action & PARSE_ACTION_MAX_TARGET; }
+
+struct ParseTablesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t terminalCount;
+    uint32_t nonTerminalCount;
+    uint32_t stateCount;
+    uint32_t ruleCount;
+    uint32_t endOfFileTerminal;
+    uint32_t stringsOffset;  // TableString[terminalCount + nonTerminalCount], indexed by symbol
+    uint32_t stringBytesSize, stringBytesOffset;
+    uint32_t statesOffset;  // TableState[stateCount]
+    uint32_t actionCount, actionsOffset;  // TableEntry[actionCount]
+    uint32_t gotoCount, gotosOffset;  // TableEntry[gotoCount]
+    uint32_t rulesOffset;  // TableRule[ruleCount]
+    uint32_t rhsSymbolCount, rhsSymbolsOffset;  // uint16_t[rhsSymbolCount]
+};
+
+struct TableString {
+    uint32_t offset;  // Into the string bytes section
+    uint32_t length;
+};
+
+// One row of each table. Entries of a row are sorted by symbol.
+struct TableState {
+    uint32_t actionsIndex;
+    uint32_t gotosIndex;
+    uint16_t actionCount;
+    uint16_t gotoCount;
+    uint16_t defaultAction;  // Taken for terminals missing from the row
+    uint16_t reserved;
+};
+
+// For actions, symbol is a terminal and value an encoded action; for gotos,
+// symbol is a nonterminal ID and value the target state.
+struct TableEntry {
+    uint16_t symbol;
+    uint16_t value;
+};
+
+struct TableRule {
+    uint16_t lhs;  // Nonterminal ID
+    uint16_t length;
+    uint32_t rhsIndex;  // Into the rhs symbols section
+};
+
+// Uncompressed tables as produced by a generator, input to writeParseTables()
+struct ParseTableSource {
+    struct Rule {
+        uint32_t lhs;  // Nonterminal ID
+        std::vector<uint32_t> rhs;  // Symbols, numbered as in the file
+    };
+    std::vector<std::string> terminals;
+    std::vector<std::string> nonTerminals;
+    std::vector<Rule> rules;
+    std::vector<std::vector<uint16_t>> actions;  // [state][terminal], encoded actions
+    std::vector<std::vector<int32_t>> gotos;  // [state][nonterminal], -1 for none
+    uint32_t endOfFileTerminal;
+};
+
+// Compresses and writes the tables, leaving the file untouched if it already
+// holds the same bytes. Throws runtime_error on I/O failure or
+// if the grammar has more states or rules than an action can encode.
+void writeParseTables(const std::string &path, const ParseTableSource &source);
+
+// Parse tables mapped read-only from a file written by writeParseTables().
+// Loading validates the file once and copies nothing.
+class ParseTables {
+public:
+    // Throws runtime_error if the file cannot be mapped or is not valid
+    explicit ParseTables(const std::string &path);
+
+    const ParseTablesHeader &header() const { return *file.at<ParseTablesHeader>(0); }
+    uint32_t terminalCount() const { return header().terminalCount; }
+    uint32_t nonTerminalCount() const { return header().nonTerminalCount; }
+    uint32_t stateCount() const { return header().stateCount; }
+    uint32_t endOfFileTerminal() const { return header().endOfFileTerminal; }
+
+    // Name of a symbol numbered as in the file
+    std::string_view symbolName(uint32_t symbol) const;
+
+    // Terminal ID for a name, or UINT32_MAX if the grammar has no such terminal
+    uint32_t findTerminal(std::string_view name) const;
+
+    uint16_t action(uint32_t state, uint32_t terminal) const;
+    uint32_t gotoState(uint32_t state, uint32_t nonTerminal) const;
+    const TableRule &rule(uint32_t index) const { return rules()[index]; }
+    std::span<const uint16_t> ruleSymbols(uint32_t index) const;
+
+private:
+    template <typename T>
+    std::span<const T> section(uint32_t offset, uint32_t count) const {
+        return {file.at<T>(offset), count};
+    }
+    std::span<const TableState> states() const { return section<TableState>(header().statesOffset, header().stateCount); }
+    std::span<const TableEntry> actions() const { return section<TableEntry>(header().actionsOffset, header().actionCount); }
+    std::span<const TableEntry> gotos() const { return section<TableEntry>(header().gotosOffset, header().gotoCount); }
+    std::span<const TableRule> rules() const { return section<TableRule>(header().rulesOffset, header().ruleCount); }
+
+    MappedFile file;
+};
+
+// A token for the table-driven parser: a terminal ID of the loaded grammar
+// and the text it was lexed from
+struct TableToken {
+    uint32_t terminal;
+    std::string_view text;
+};
+
+// Parse tree node built by parseWithTables(). Terminals have no children.
+struct TableParseNode {
+    uint32_t symbol;  // Numbered as in the tables
+    std::string_view text;
+    std::span<TableParseNode *> children;
+};
+
+// Parses tokens with loaded tables. The end of file token is implied after
+// the last one. Throws runtime_error on a syntax error, or if the tables
+// keep reducing without shifting, as a cycle of unit or empty rules would.
+TableParseNode *parseWithTables(const ParseTables &tables, std::span<const TableToken> tokens, Arena &arena);
+
+void printTableParseTree(const ParseTables &tables, const TableParseNode *root);
+
+#endif // PARSE_TABLES_H
@@ -1,238 +1,281 @@
+#include <algorithm>
+#include <csignal>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <vector>
-#include <stack>
-#include <map>
 #include <string>
-#include <sstream>
 #include <stdexcept>
-#include "parser.h"  // Include the generated header file
-#include "cst.h"
+#include <thread>
+#include "ast.h"
+#include "bytecode.h"
+#include "cst_writer.h"
+#include "diagnostics.h"
+#include "optimizer.h"
+#include "parse_profile.h"
+#include "parse_server.h"
+#include "parse_tables.h"
+#include "program_image.h"
+#include "script_parser.h"
 
 using namespace std;
 
-// struct CSTNode {
-//     string symbol;  // The symbol of this node (terminal or non-terminal)
-//     string value;  // The value of this node
-//     vector<CSTNode*> children;  // The children of this node (for non-terminals)
-    
-//     CSTNode(const string& symbol) : symbol(symbol) {}
-//     CSTNode(const string& symbol, const string& value) : symbol(symbol), value(value) {}
-
-//     // Function to add a child node
-//     void addChild(CSTNode* child) {
-//         children.push_back(child);
-//     }
-
-//     // Function to print the tree (for debugging purposes)
-//     void print(int level = 0) const {
-//         for (int i = 0; i < level; ++i) cout << "  ";  // Indentation for depth
-//         cout << symbol;
-//         if (!value.empty()) {
-//             cout << " (" << value << ")";
-//         }
-//         cout << endl;
-//         for (auto* child : children) {
-//             child->print(level + 1);
-//         }
-//     }
-// };
-
-// The LR(1) parser function
-CSTNode* parse(const vector<CSTNode *>& input) {
-    stack<int> stateStack;  // Stack to store states
-    stack<CSTNode*> astStack;  // Stack to store AST nodes for each symbol
-    
-    stateStack.push(0);  // Initial state is 0
-    
-    size_t inputIndex = 0;  // Pointer to the current symbol in the input
-    CSTNode *currentSymbol = input[inputIndex];  // Current symbol to process
-    
-    while (true) {
-        int currentState = stateStack.top();  // Top of the state stack
-        CSTTerminalNodeType type = dynamic_cast<CSTTerminalNode*>(currentSymbol)->type;
-        cout << "Current State: " << currentState << ", Current Symbol: " << cstTerminalNodeTypeToString(type) << endl;
-
-        // Get the action for the current state and symbol
-        Action currentAction = actionTable[currentState][type];
-
-        // Handle the action
-        switch (currentAction.actionType) {
-            case Action::SHIFT: {
-                // Perform shift: push the new state and create an AST node for the symbol
-                cout << "Action: SHIFT, Next State: " << currentAction.stateOrRule << endl;
-                stateStack.push(currentAction.stateOrRule);  // Shift to the new state
-                astStack.push(currentSymbol);  // Push the AST node onto the stack
-                inputIndex++;  // Move to the next symbol in the input
-                if (inputIndex < input.size()) {
-                    currentSymbol = input[inputIndex];  // Update current symbol
-                } else {
-                    currentSymbol = new CSTTerminalNode(CSTTerminalNodeType::END_OF_FILE);
-                }
-                break;
-            }
-
-            case Action::REDUCE: {
-                // Perform reduce: pop symbols and states according to the rule
-                int ruleIndex = currentAction.stateOrRule;
-                const Rule& rule = grammar[ruleIndex];
-                cout << "Action: REDUCE by rule " << ruleIndex << ": " << rule.lhs << " -> ";
-                for (const string& symbol : rule.rhs) {
-                    cout << symbol << " ";
-                }
-                cout << endl;
-
-                // Pop symbols and states from the stacks
-                vector<CSTNode*> rhsNodes;
-                for (size_t i = 0; i < rule.rhs.size(); ++i) {
-                    stateStack.pop();
-                    CSTNode* rhsNode = astStack.top();
-                    astStack.pop();
-                    rhsNodes.push_back(rhsNode);  // Collect the AST nodes for the RHS symbols
-                }
-
-                // Create a new AST node for the left-hand side (LHS) of the rule
-                CSTNode* parentNode = new CSTNode((CSTNodeType)nonTerminalToID.at(rule.lhs));
-
-                // Reverse the order of the RHS nodes
-                reverse(rhsNodes.begin(), rhsNodes.end());
-
-                // Add the RHS nodes as children of the parent node
-                for (auto* rhsNode : rhsNodes) {
-                    parentNode->addChild(rhsNode);
-                }
+static ParseServer *activeServer = nullptr;
 
-                // Get the state to go to from the goto table
-                int nextState = gotoTable[stateStack.top()][nonTerminalToID.at(rule.lhs)].state;
-                cout << "Goto state: " << nextState << endl;
+static void stopServer(int) {
+    activeServer->stop();
+}
 
-                // Push the non-terminal and the new state onto the stack
-                stateStack.push(nextState);
-                astStack.push(parentNode);  // Push the parent node onto the AST stack
+// parser --serve <socket> [--workers <count>]: answers parse requests until
+// SIGINT or SIGTERM, then prints the latency counters
+static int serve(int argc, char* argv[]) {
+    size_t workerCount = max(thread::hardware_concurrency(), 1u);
+    if (argc == 5 && string(argv[3]) == "--workers") {
+        workerCount = stoul(argv[4]);
+    } else if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " --serve <socket> [--workers <count>]" << endl;
+        return 1;
+    }
 
-                break;
-            }
+    try {
+        ParseServer server(argv[2], workerCount);
+        activeServer = &server;
+        signal(SIGINT, stopServer);
+        signal(SIGTERM, stopServer);
+        cerr << "Serving on " << argv[2] << " with " << workerCount << " workers" << endl;
+        server.run();
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        LatencyStats stats = server.latency();
+        cerr << "Requests: " << stats.requests << ", p50: " << stats.p50Microseconds << " us, p99: "
+             << stats.p99Microseconds << " us" << endl;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
 
-            case Action::ACCEPT:
-                cout << "Action: ACCEPT. Parsing is complete!" << endl;
-                return astStack.top();
+// A NUMBER keeps its value rather than a spelling, so one is interned here
+// for the paths that work on token text
+static string_view terminalText(const CSTTerminalNode *terminal, SymbolTable &symbols) {
+    char buffer[24];
+    string_view text = terminal->spelling(buffer);
+    return terminal->hasInteger ? symbols.name(symbols.intern(text)) : text;
+}
 
-            case Action::NONE:
-                throw runtime_error("Parsing error: No action available.");
-        }
+// Prints every syntax error with its line and column, in input order
+static void reportSyntaxErrors(const vector<SyntaxError> &errors, const string &source) {
+    LineIndex lines(source);
+    for (const SyntaxError &error : errors) {
+        cerr << "Error: " << lines.describe(error) << endl;
     }
 }
 
-// Tokenizer function that returns CSTNode instances for recognized tokens
-vector<CSTNode*> tokenize(const string& input) {
-    vector<CSTNode*> tokens;
-    int index = 0;
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && string(argv[1]) == "--serve") {
+        return serve(argc, argv);
+    }
 
-    while (index < input.length()) {
-        if (isspace(input[index])) {
-            index++;  // Skip whitespace
+    string cacheDirectory;
+    string tablesPath;
+    string profileJSONPath;
+    bool checkOnly = false;
+    bool forest = false;
+    bool pipelined = false;
+    bool profiling = false;
+    CSTFormat cstFormat = CSTFormat::TREE;
+    int argi = 1;
+    while (argi + 1 < argc) {
+        if (string(argv[argi]) == "--check") {
+            checkOnly = true;
+            argi += 1;
+            continue;
+        }
+        if (string(argv[argi]) == "--glr") {
+            forest = true;
+            argi += 1;
             continue;
         }
-        static const map<char, CSTTerminalNodeType> operatorMap = {
-            {',', CSTTerminalNodeType::COMMA},
-            {';', CSTTerminalNodeType::SEMICOLON},
-            {'{', CSTTerminalNodeType::LEFT_BRACE},
-            {'}', CSTTerminalNodeType::RIGHT_BRACE},
-            {'(', CSTTerminalNodeType::LEFT_PARENTHESIS},
-            {')', CSTTerminalNodeType::RIGHT_PARENTHESIS},
-            {'+', CSTTerminalNodeType::PLUS},
-            {'-', CSTTerminalNodeType::MINUS},
-            {'*', CSTTerminalNodeType::ASTERISK},
-            {'/', CSTTerminalNodeType::SLASH},
-        };
-
-        auto operatorIter = operatorMap.find(input[index]);
-        if (operatorIter != operatorMap.end()) {
-            tokens.push_back(new CSTTerminalNode(operatorIter->second));
-            index++;
+        if (string(argv[argi]) == "--pipeline") {
+            pipelined = true;
+            argi += 1;
             continue;
         }
+        if (string(argv[argi]) == "--profile") {
+            profiling = true;
+            argi += 1;
+            continue;
+        }
+        if (argi + 2 >= argc) {
+            break;
+        }
+        if (string(argv[argi]) == "--cache-dir") {
+            cacheDirectory = argv[argi + 1];
+        } else if (string(argv[argi]) == "--tables") {
+            tablesPath = argv[argi + 1];
+        } else if (string(argv[argi]) == "--cst-format") {
+            cstFormat = parseCSTFormat(argv[argi + 1]);
+        } else if (string(argv[argi]) == "--profile-json") {
+            profileJSONPath = argv[argi + 1];
+            profiling = true;
+        } else {
+            break;
+        }
+        argi += 2;
+    }
+    if (argi + 1 != argc) {
+        cerr << "Usage: " << argv[0] << " [--check] [--glr] [--pipeline] [--cache-dir <dir>] [--tables <parse_tables>]\n    [--cst-format tree|sexpr|jsonl] [--profile] [--profile-json <file>] <input_file>\n"
+             << "       " << argv[0] << " --serve <socket> [--workers <count>]" << endl;
+        return 1;
+    }
+    if (profiling && !SCRIPT_PROFILING) {
+        cerr << "Profiling is not compiled in; reconfigure with -DSCRIPT_PROFILING=ON" << endl;
+        return 1;
+    }
+    if (profiling && pipelined) {
+        cerr << "A pipelined parse cannot be profiled; its phases overlap" << endl;
+        return 1;
+    }
 
-        static const map<string, CSTTerminalNodeType> keywordMap = {
-            {"return", CSTTerminalNodeType::RETURN},
-            {"int",    CSTTerminalNodeType::INT},
-        };
+    string inputString = readFile(argv[argi]);
+    SymbolTable symbols;
 
-        for (const auto& keywordPair : keywordMap) {
-            if (input.substr(index, keywordPair.first.length()) == keywordPair.first) {
-                tokens.push_back(new CSTTerminalNode(keywordPair.second));
-                index += keywordPair.first.length();
-                break;
+    try {
+        // Syntax check only: no tokens or tree are ever allocated
+        if (checkOnly) {
+            vector<SyntaxError> syntaxErrors;
+            validate(inputString, syntaxErrors);
+            if (!syntaxErrors.empty()) {
+                reportSyntaxErrors(syntaxErrors, inputString);
+                return 1;
             }
+            cout << "OK" << endl;
+            return 0;
         }
 
-        // Handle IDENTIFIER
-        if (isalpha(input[index]) || input[index] == '_') {
-            string identifier;
-            while (index < input.length() && (isalnum(input[index]) || input[index] == '_')) {
-                identifier += input[index++];
+        // Parse with tables loaded at runtime instead of the compiled-in ones
+        if (!tablesPath.empty()) {
+            ParseTables tables(tablesPath);
+            vector<TableToken> tokens;
+            for (CSTNode *node : tokenize(inputString, symbols, false)) {
+                auto *terminal = static_cast<CSTTerminalNode *>(node);
+                string name = cstTerminalNodeTypeToString(terminal->type);
+                uint32_t id = tables.findTerminal(name);
+                if (id == UINT32_MAX) {
+                    throw runtime_error("Grammar has no terminal " + name);
+                }
+                tokens.push_back({id, terminalText(terminal, symbols)});
             }
-            CSTNode* identifierNode = new CSTTerminalNode(CSTTerminalNodeType::IDENTIFIER, identifier);
-            tokens.push_back(identifierNode);
-            continue;
+            Arena treeArena;
+            TableParseNode *root = parseWithTables(tables, tokens, treeArena);
+            cout << "Parse tree for the input:" << endl;
+            printTableParseTree(tables, root);
+            return 0;
         }
 
-        // Handle NUMBER
-        if (isdigit(input[index])) {
-            string number;
-            while (index < input.length() && isdigit(input[index])) {
-                number += input[index++];
-            }
-            CSTNode* numberNode = new CSTTerminalNode(CSTTerminalNodeType::NUMBER, number);
-            tokens.push_back(numberNode);
-            continue;
+        // Generalized LR, printing the shared packed parse forest
+        if (forest) {
+            vector<CSTNode *> tokens = tokenize(inputString, symbols, false);
+            Arena forestArena;
+            SPPFNode *root = parseForest(tokens, forestArena);
+            cout << "Parse forest for the input:" << endl;
+            printForest<ParserTables>(root, [&](uint32_t index) {
+                return index < tokens.size() ? terminalText(static_cast<CSTTerminalNode *>(tokens[index]), symbols) : string_view();
+            });
+            return 0;
         }
 
-        // Handle unrecognized characters (optional: throw error)
-        cerr << "Unrecognized character: " << input[index] << endl;
-        index++;
-    }
-
-    // Add end of input symbol
-    tokens.push_back(new CSTTerminalNode(CSTTerminalNodeType::END_OF_FILE));
-    
-    // For debugging: print tokens
-    for (const auto& token : tokens) {
-        token->print();
-    }
-
-    return tokens;
-}
+        // A cached image skips lexing, parsing, lowering and compilation
+        if (!cacheDirectory.empty()) {
+            if (unique_ptr<MappedProgram> image = loadCachedProgram(cacheDirectory, inputString)) {
+                image->loadSymbols(symbols);
+                Arena astArena;
+                ASTProgram* astRoot = image->loadAST(astArena);
+                cout << "Optimized AST for the input (cached):" << endl;
+                printAST(astRoot, symbols);
+                if (image->hasBytecode()) {
+                    BytecodeProgram program = image->loadBytecode(symbols);
+                    cout << "Bytecode for the input (cached):" << endl;
+                    printBytecode(program);
+                }
+                return 0;
+            }
+        }
 
-string readFile(const string& filename) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        throw runtime_error("Failed to open file: " + filename);
-    }
-    stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
+        // Lexing happens up front here, so the driver's lexer only replays
+        // tokens and tokenize() is timed as the lexing phase instead. Tracing
+        // would swamp the timings, so a profiled run does not trace. Neither
+        // does a pipelined one, where lexing and parsing overlap.
+        optional<ParseProfile> profile;
+        if (profiling) {
+            profile.emplace(NUM_STATES, NUM_RULES);
+        }
+        vector<CSTNode *> input;
+        vector<SyntaxError> syntaxErrors;
+        CSTNode* cstRoot;
+        if (pipelined) {
+            cstRoot = parsePipelined(inputString, symbols, input);
+        } else {
+            uint64_t lexStart = profile ? readCycleCounter() : 0;
+            input = tokenize(inputString, symbols, !profile);
+            if (profile) {
+                profile->lexCycles += readCycleCounter() - lexStart;
+            }
+            // Start parsing and generate the CST, with ERROR terminals where
+            // the parse recovered from a syntax error
+            cstRoot = parseRecovering(input, syntaxErrors, !profile, profile ? &*profile : nullptr);
+        }
+        if (cstRoot && !syntaxErrors.empty()) {
+            cout << "CST for the input, with errors:" << endl;
+            writeCST(cstRoot, cstFormat);
+            reportSyntaxErrors(syntaxErrors, inputString);
+        } else if (cstRoot) {
+            cout << "CST for the input:" << endl;
+            writeCST(cstRoot, cstFormat);  // Print the CST
+
+            Arena astArena;
+            ASTProgram* astRoot = lowerToAST(cstRoot, astArena, symbols);
+            cout << "AST for the input:" << endl;
+            printAST(astRoot, symbols);
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <input_file>" << endl;
-        return 1;
-    }
+            OptimizationStats optimizationStats;
+            optimizeProgram(astRoot, astArena, optimizationStats);
+            cout << "Optimized AST for the input:" << endl;
+            printAST(astRoot, symbols);
+            printOptimizationStats(optimizationStats);
 
-    string inputString = readFile(argv[1]);
-    vector<CSTNode *> input = tokenize(inputString);
+            BytecodeProgram program = compileProgram(astRoot, symbols);
+            cout << "Bytecode for the input:" << endl;
+            printBytecode(program);
 
-    try {
-        CSTNode* astRoot = parse(input);  // Start parsing and generate the AST
-        if (astRoot) {
-            cout << "AST for the input:" << endl;
-            astRoot->print();  // Print the AST
+            if (!cacheDirectory.empty()) {
+                uint64_t sourceHash = hashSource(inputString);
+                writeProgramImage(programImagePath(cacheDirectory, sourceHash), sourceHash, astRoot, &program, symbols);
+            }
         } else {
-            cout << "No AST generated." << endl;
+            cout << "No CST generated." << endl;
+        }
+
+        if (profile) {
+            span<const char *const> ruleText(ParserTables::ruleText, NUM_RULES);
+            if (!profileJSONPath.empty()) {
+                ofstream file(profileJSONPath);
+                writeParseProfileJSON(*profile, ruleText, span<const uint16_t>(ParserTables::generatorStates, NUM_STATES), file);
+                if (!file) {
+                    throw runtime_error("Failed to write file: " + profileJSONPath);
+                }
+            } else {
+                cout << "Parse profile:" << endl;
+                printParseProfile(*profile, ruleText, cout);
+            }
         }
+    } catch (const SyntaxError& e) {
+        cerr << "Error: " << LineIndex(inputString).describe(e) << endl;
+        return checkOnly ? 1 : 0;
     } catch (const runtime_error& e) {
         cerr << "Error: " << e.what() << endl;
+        return checkOnly ? 1 : 0;
     }
 
     return 0;
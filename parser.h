@@ -1,203 +1,186 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include <algorithm>
-#include <string>
-#include <map>
-#include <vector>
+#include <cstdint>
 
-struct Action {
-    enum ActionType {
-        SHIFT,
-        REDUCE,
-        ACCEPT,
-        NONE
-    };
-    ActionType actionType;
-    int stateOrRule; // For SHIFT: state; For REDUCE: rule index
-};
+static const int NUM_TERMINALS = 16;
+static const int NUM_NON_TERMINALS = 11;
+static const int NUM_STATES = 46;
+static const int NUM_RULES = 25;
 
-struct Goto {
-    int state;  // The state to go to for a non-terminal
-};
+// Tables for LRDriver (lr_driver.h). Actions: 0 is an error, n > 0 shifts to
+// state n, n < 0 reduces by rule -n - 1 and INT16_MIN accepts.
+struct ParserTables {
+    static constexpr const char *terminalNames[NUM_TERMINALS] = {
+        "IDENTIFIER",
+        "LEFT_PARENTHESIS",
+        "RIGHT_PARENTHESIS",
+        "LEFT_BRACE",
+        "RIGHT_BRACE",
+        "INT",
+        "COMMA",
+        "RETURN",
+        "SEMICOLON",
+        "PLUS",
+        "MINUS",
+        "ASTERISK",
+        "SLASH",
+        "NUMBER",
+        "ERROR",
+        "END_OF_FILE",
+    };
 
-struct Rule {
-    std::string lhs;  // Left-hand side of the rule
-    std::vector<std::string> rhs;  // Right-hand side of the rule (sequence of symbols)
-};
+    static constexpr int errorTerminal = 14;
+    static constexpr int endOfFileTerminal = 15;
 
-static const int NUM_TERMINALS = 15;
-static const int NUM_NON_TERMINALS = 11;
-static const int NUM_STATES = 42;
+    static constexpr const char *nonTerminalNames[NUM_NON_TERMINALS] = {
+        "program",
+        "functionList",
+        "function",
+        "type",
+        "parameterList",
+        "parameter",
+        "statementList",
+        "statement",
+        "expression",
+        "term",
+        "factor",
+    };
 
-static const std::map<std::string, int> terminalToID = {
-    {"ASTERISK", 11},
-    {"COMMA", 6},
-    {"END_OF_FILE", 14},
-    {"IDENTIFIER", 0},
-    {"INT", 5},
-    {"LEFT_BRACE", 3},
-    {"LEFT_PARENTHESIS", 1},
-    {"MINUS", 10},
-    {"NUMBER", 13},
-    {"PLUS", 9},
-    {"RETURN", 7},
-    {"RIGHT_BRACE", 4},
-    {"RIGHT_PARENTHESIS", 2},
-    {"SEMICOLON", 8},
-    {"SLASH", 12},
-};
+    static constexpr const char *ruleText[NUM_RULES] = {
+        "program -> functionList ",
+        "functionList -> functionList function ",
+        "functionList -> function ",
+        "function -> type IDENTIFIER LEFT_PARENTHESIS parameterList RIGHT_PARENTHESIS LEFT_BRACE statementList RIGHT_BRACE ",
+        "function -> type IDENTIFIER LEFT_PARENTHESIS RIGHT_PARENTHESIS LEFT_BRACE statementList RIGHT_BRACE ",
+        "function -> ERROR RIGHT_BRACE ",
+        "function -> ERROR ",
+        "type -> INT ",
+        "parameterList -> parameterList COMMA parameter ",
+        "parameterList -> parameter ",
+        "parameter -> type IDENTIFIER ",
+        "statementList -> statementList statement ",
+        "statementList -> statement ",
+        "statement -> RETURN expression SEMICOLON ",
+        "statement -> ERROR SEMICOLON ",
+        "statement -> ERROR ",
+        "expression -> expression PLUS term ",
+        "expression -> expression MINUS term ",
+        "expression -> term ",
+        "term -> term ASTERISK factor ",
+        "term -> term SLASH factor ",
+        "term -> factor ",
+        "factor -> LEFT_PARENTHESIS expression RIGHT_PARENTHESIS ",
+        "factor -> IDENTIFIER ",
+        "factor -> NUMBER ",
+    };
 
-static const std::map<std::string, int> nonTerminalToID = {
-    {"expression", 8},
-    {"factor", 10},
-    {"function", 2},
-    {"functionList", 1},
-    {"parameter", 5},
-    {"parameterList", 4},
-    {"program", 0},
-    {"statement", 7},
-    {"statementList", 6},
-    {"term", 9},
-    {"type", 3},
-};
+    static constexpr uint16_t ruleLength[NUM_RULES] = { 1, 2, 1, 8, 7, 2, 1, 1, 3, 1, 2, 2, 1, 3, 2, 1, 3, 3, 1, 3, 3, 1, 3, 1, 1, };
+    static constexpr uint16_t ruleLhs[NUM_RULES] = { 0, 1, 1, 2, 2, 2, 2, 3, 4, 4, 5, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 10, };
 
-static const std::vector<std::vector<Action>> actionTable = {
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::REDUCE, 5}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 2}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 2}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::ACCEPT, -1}, },
-    { {Action::SHIFT, 6}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 1}, },
-    { {Action::NONE, -1}, {Action::SHIFT, 7}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 8}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 12}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 7}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 7}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 14}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 13}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 15}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 16}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 20}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 8}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 8}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 21}, {Action::SHIFT, 22}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 23}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 10}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 10}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 27}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 16}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 6}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 6}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 16}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 19}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 19}, {Action::REDUCE, 19}, {Action::REDUCE, 19}, {Action::REDUCE, 19}, {Action::REDUCE, 19}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 21}, {Action::SHIFT, 22}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 23}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 20}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 20}, {Action::REDUCE, 20}, {Action::REDUCE, 20}, {Action::REDUCE, 20}, {Action::REDUCE, 20}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 33}, {Action::SHIFT, 32}, {Action::SHIFT, 31}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 17}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 17}, {Action::REDUCE, 17}, {Action::REDUCE, 17}, {Action::REDUCE, 17}, {Action::REDUCE, 17}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 14}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 14}, {Action::REDUCE, 14}, {Action::REDUCE, 14}, {Action::SHIFT, 34}, {Action::SHIFT, 35}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 4}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 4}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 9}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 9}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 36}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 16}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 37}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 32}, {Action::SHIFT, 31}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 21}, {Action::SHIFT, 22}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 23}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 21}, {Action::SHIFT, 22}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 23}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 11}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 11}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 21}, {Action::SHIFT, 22}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 23}, {Action::NONE, -1}, },
-    { {Action::SHIFT, 21}, {Action::SHIFT, 22}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::SHIFT, 23}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 3}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 3}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 18}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 18}, {Action::REDUCE, 18}, {Action::REDUCE, 18}, {Action::REDUCE, 18}, {Action::REDUCE, 18}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 13}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 13}, {Action::REDUCE, 13}, {Action::REDUCE, 13}, {Action::SHIFT, 34}, {Action::SHIFT, 35}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 12}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 12}, {Action::REDUCE, 12}, {Action::REDUCE, 12}, {Action::SHIFT, 34}, {Action::SHIFT, 35}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 15}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 15}, {Action::REDUCE, 15}, {Action::REDUCE, 15}, {Action::REDUCE, 15}, {Action::REDUCE, 15}, {Action::NONE, -1}, {Action::NONE, -1}, },
-    { {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 16}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::NONE, -1}, {Action::REDUCE, 16}, {Action::REDUCE, 16}, {Action::REDUCE, 16}, {Action::REDUCE, 16}, {Action::REDUCE, 16}, {Action::NONE, -1}, {Action::NONE, -1}, },
-};
+    static constexpr int16_t actions[NUM_STATES][NUM_TERMINALS] = {
+        { 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, },
+        { 0, 0, 0, 0, 6, -7, 0, 0, 0, 0, 0, 0, 0, 0, -7, -7, },
+        { -8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 0, 0, -3, 0, 0, 0, 0, 0, 0, 0, 0, -3, -3, },
+        { 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 1, -32768, },
+        { 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 0, 0, -6, 0, 0, 0, 0, 0, 0, 0, 0, -6, -6, },
+        { 0, 0, 0, 0, 0, -2, 0, 0, 0, 0, 0, 0, 0, 0, -2, -2, },
+        { 0, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 10, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, -10, 0, 0, 0, -10, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 16, 0, 0, 0, 15, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 0, 0, 0, 0, 19, 0, 0, 0, 0, 0, 0, 18, 0, },
+        { 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, -11, 0, 0, 0, -11, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 0, -16, 0, 0, -16, 24, 0, 0, 0, 0, 0, -16, 0, },
+        { 25, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, },
+        { 0, 0, 0, 0, -13, 0, 0, -13, 0, 0, 0, 0, 0, 0, -13, 0, },
+        { 0, 0, 0, 0, 31, 0, 0, 19, 0, 0, 0, 0, 0, 0, 18, 0, },
+        { 0, 0, -9, 0, 0, 0, -9, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
+        { 0, 0, 0, 0, 0, 0, 0, 19, 0, 0, 0, 0, 0, 0, 18, 0, },
+        { 0, 0, 0, 0, -15, 0, 0, -15, 0, 0, 0, 0, 0, 0, -15, 0, },
+        { 0, 0, -24, 0, 0, 0, 0, 0, -24, -24, -24, -24, -24, 0, 0, 0, },
+        { 25, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, },
+        { 0, 0, -25, 0, 0, 0, 0, 0, -25, -25, -25, -25, -25, 0, 0, 0, },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 37, 36, 35, 0, 0, 0, 0, 0, },
+        { 0, 0, -22, 0, 0, 0, 0, 0, -22, -22, -22, -22, -22, 0, 0, 0, },
+        { 0, 0, -19, 0, 0, 0, 0, 0, -19, -19, -19, 38, 39, 0, 0, 0, },
+        { 0, 0, 0, 0, 0, -5, 0, 0, 0, 0, 0, 0, 0, 0, -5, -5, },
+        { 0, 0, 0, 0, -12, 0, 0, -12, 0, 0, 0, 0, 0, 0, -12, 0, },
+        { 0, 0, 0, 0, 40, 0, 0, 19, 0, 0, 0, 0, 0, 0, 18, 0, },
+        { 0, 0, 41, 0, 0, 0, 0, 0, 0, 36, 35, 0, 0, 0, 0, 0, },
+        { 25, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, },
+        { 25, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, },
+        { 0, 0, 0, 0, -14, 0, 0, -14, 0, 0, 0, 0, 0, 0, -14, 0, },
+        { 25, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, },
+        { 25, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, },
+        { 0, 0, 0, 0, 0, -4, 0, 0, 0, 0, 0, 0, 0, 0, -4, -4, },
+        { 0, 0, -23, 0, 0, 0, 0, 0, -23, -23, -23, -23, -23, 0, 0, 0, },
+        { 0, 0, -18, 0, 0, 0, 0, 0, -18, -18, -18, 38, 39, 0, 0, 0, },
+        { 0, 0, -17, 0, 0, 0, 0, 0, -17, -17, -17, 38, 39, 0, 0, 0, },
+        { 0, 0, -20, 0, 0, 0, 0, 0, -20, -20, -20, -20, -20, 0, 0, 0, },
+        { 0, 0, -21, 0, 0, 0, 0, 0, -21, -21, -21, -21, -21, 0, 0, 0, },
+    };
 
-static const std::vector<std::vector<Goto>> gotoTable = {
-    { {-1}, {3}, {2}, {4}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {5}, {4}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {11}, {10}, {9}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {18}, {17}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {11}, {-1}, {19}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {24}, {26}, {25}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {28}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {29}, {17}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {30}, {26}, {25}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {28}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {38}, {25}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {39}, {25}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {40}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {41}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-    { {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, {-1}, },
-};
+    static constexpr int conflictCount = 0;
+    static constexpr uint16_t conflictStart[conflictCount + 1] = { 0, };
+    static constexpr int16_t conflictActions[1] = { 0, };
 
-static const std::map<int, int> ruleSymbolCount = {
-    {0, 1},
-    {1, 2},
-    {2, 1},
-    {3, 8},
-    {4, 7},
-    {5, 1},
-    {6, 3},
-    {7, 1},
-    {8, 2},
-    {9, 2},
-    {10, 1},
-    {11, 3},
-    {12, 3},
-    {13, 3},
-    {14, 1},
-    {15, 3},
-    {16, 3},
-    {17, 1},
-    {18, 3},
-    {19, 1},
-    {20, 1},
-};
+    static constexpr int16_t gotos[NUM_STATES][NUM_NON_TERMINALS] = {
+        { -1, 4, 3, 5, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, 7, 5, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, 13, 12, 11, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, 21, 20, -1, -1, -1, },
+        { -1, -1, -1, 13, -1, 22, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, 28, 30, 29, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, 32, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, 33, 20, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, 34, 30, 29, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, 32, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, 42, 29, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, 43, 29, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 44, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 45, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, },
+    };
 
-static const std::vector<Rule> grammar = {
-    {"program", {"functionList"}},
-    {"functionList", {"functionList", "function"}},
-    {"functionList", {"function"}},
-    {"function", {"type", "IDENTIFIER", "LEFT_PARENTHESIS", "parameterList", "RIGHT_PARENTHESIS", "LEFT_BRACE", "statementList", "RIGHT_BRACE"}},
-    {"function", {"type", "IDENTIFIER", "LEFT_PARENTHESIS", "RIGHT_PARENTHESIS", "LEFT_BRACE", "statementList", "RIGHT_BRACE"}},
-    {"type", {"INT"}},
-    {"parameterList", {"parameterList", "COMMA", "parameter"}},
-    {"parameterList", {"parameter"}},
-    {"parameter", {"type", "IDENTIFIER"}},
-    {"statementList", {"statementList", "statement"}},
-    {"statementList", {"statement"}},
-    {"statement", {"RETURN", "expression", "SEMICOLON"}},
-    {"expression", {"expression", "PLUS", "term"}},
-    {"expression", {"expression", "MINUS", "term"}},
-    {"expression", {"term"}},
-    {"term", {"term", "ASTERISK", "factor"}},
-    {"term", {"term", "SLASH", "factor"}},
-    {"term", {"factor"}},
-    {"factor", {"LEFT_PARENTHESIS", "expression", "RIGHT_PARENTHESIS"}},
-    {"factor", {"IDENTIFIER"}},
-    {"factor", {"NUMBER"}},
+    static constexpr uint16_t generatorStates[NUM_STATES] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, };
 };
 
 #endif // PARSER_H
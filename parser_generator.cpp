@@ -1,5 +1,4 @@
 #include <cassert>
-#include <functional>
 #include <algorithm>
 #include <fstream>
 #include <iostream>
@@ -9,16 +8,21 @@
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "parse_tables.h"
+
 using namespace std;
 
 // Struct to represent a Grammar Rule
 struct Rule {
   string lhs;
   vector<string> rhs;
+  string action; // Semantic action from the grammar file, or empty
 
-  Rule(const string &lhs, const vector<string> &rhs) : lhs(lhs), rhs(rhs) {}
+  Rule(const string &lhs, const vector<string> &rhs, const string &action = "")
+      : lhs(lhs), rhs(rhs), action(action) {}
 
   bool operator<(const Rule &other) const {
     return tie(lhs, rhs) < tie(other.lhs, other.rhs);
@@ -78,6 +82,10 @@ struct Action {
   Action(ActionType actionType = NONE, int stateOrRule = -1)
       : actionType(actionType), stateOrRule(stateOrRule) {}
 
+  bool operator==(const Action &other) const {
+    return actionType == other.actionType && stateOrRule == other.stateOrRule;
+  }
+
   string toString() const {
     switch (actionType) {
     case SHIFT:
@@ -105,6 +113,14 @@ vector<vector<Action>>
     actionTable; // state -> terminal symbol -> Action (Shift/Reduce/Accept)
 vector<vector<Goto>> gotoTable; // state -> non-terminal -> new state
 
+// Every action of each cell that got more than one. actionTable keeps the
+// last one written, which is what a deterministic parser gets.
+map<pair<int, int>, vector<Action>> conflicts; // (state, terminal) -> actions
+
+// With --glr, conflicted cells are emitted for GLRDriver instead of being
+// resolved
+bool glrMode = false;
+
 map<string, int> terminalToID;    // Mapping terminals to IDs
 map<string, int> nonTerminalToID; // Mapping non-terminals to IDs
 vector<string> terminals;         // List of terminal symbols
@@ -234,6 +250,27 @@ set<LR1Item> closure(const set<LR1Item> &items) {
   return result;
 }
 
+// Closures kept from the previous run by --cache, keyed by kernel. Only
+// closures that expanded no changed symbol are loaded, so every entry is
+// still exact.
+map<set<LR1Item>, set<LR1Item>> closureCache;
+map<set<LR1Item>, set<LR1Item>> closures; // This run's, saved for the next
+size_t reusedClosures = 0;
+
+// The closure of a kernel, computed at most once per run
+set<LR1Item> cachedClosure(const set<LR1Item> &kernel) {
+  auto known = closures.find(kernel);
+  if (known != closures.end()) {
+    return known->second;
+  }
+  auto cached = closureCache.find(kernel);
+  set<LR1Item> result =
+      cached != closureCache.end() ? cached->second : closure(kernel);
+  reusedClosures += cached != closureCache.end();
+  closures.emplace(kernel, result);
+  return result;
+}
+
 // Function to compute the goto operation on a set of items by a symbol
 set<LR1Item> gotoSet(const set<LR1Item> &items, const string &symbol) {
   set<LR1Item> result;
@@ -245,7 +282,7 @@ set<LR1Item> gotoSet(const set<LR1Item> &items, const string &symbol) {
       result.insert(newItem);
     }
   }
-  return closure(result);
+  return cachedClosure(result);
 }
 
 // Function to print the action and goto tables
@@ -261,6 +298,15 @@ void printParseTable() {
     }
   }
 
+  for (const auto &[cell, actions] : conflicts) {
+    cout << "Conflict in state " << cell.first << ", Symbol "
+         << terminals[cell.second] << ":";
+    for (const auto &action : actions) {
+      cout << " " << action.toString() << ";";
+    }
+    cout << "\n";
+  }
+
   // Print Goto Table
   cout << "\nGoto Table:\n";
   for (size_t state = 0; state < gotoTable.size(); ++state) {
@@ -277,12 +323,31 @@ void printParseTable() {
 
 vector<set<LR1Item>> states; // List of LR(1) states
 
+// Sets an action, recording a conflict if the cell already has another one
+void setAction(int state, int terminalID, const Action &action) {
+  Action &cell = actionTable[state][terminalID];
+  if (cell.actionType != Action::NONE && !(cell == action)) {
+    vector<Action> &actions = conflicts[{state, terminalID}];
+    if (actions.empty()) {
+      actions.push_back(cell);
+    }
+    if (find(actions.begin(), actions.end(), action) == actions.end()) {
+      actions.push_back(action);
+    }
+  }
+  cell = action;
+}
+
 // Function to generate the LR(1) parse table
 void generateLR1ParseTable() {
   map<set<LR1Item>, int> stateToID; // Mapping from set of items to state ID
+  map<Rule, int> ruleIndex;         // First rule with each lhs and rhs
+  for (size_t i = grammar.size(); i-- > 0;) {
+    ruleIndex[grammar[i]] = i;
+  }
 
   LR1Item startItem(grammar[0].lhs, grammar[0].rhs, 0, "END_OF_FILE");
-  set<LR1Item> initialState = closure({startItem});
+  set<LR1Item> initialState = cachedClosure({startItem});
   states.push_back(initialState);
   stateToID[initialState] = 0;
 
@@ -321,8 +386,8 @@ void generateLR1ParseTable() {
           stateToID[nextState] = stateCounter++;
           stateQueue.push(nextState);
         }
-        actionTable[currentStateID][symbolID] =
-            Action(Action::SHIFT, stateToID[nextState]);
+        setAction(currentStateID, symbolID,
+                  Action(Action::SHIFT, stateToID[nextState]));
       } else if (nonTerminalToID.find(symbol) != nonTerminalToID.end()) {
         symbolID = nonTerminalToID[symbol];
         set<LR1Item> nextState = gotoSet(currentState, symbol);
@@ -340,25 +405,319 @@ void generateLR1ParseTable() {
       if (item.dotPosition == item.rhs.size()) {
         // If dot is at the end of the production, perform reduction
         if (item.lhs != grammar[0].lhs) { // Exclude start production
-          int ruleId =
-              distance(grammar.begin(), find_if(grammar.begin(), grammar.end(),
-                                                [&item](const Rule &rule) {
-                                                  return rule.lhs == item.lhs &&
-                                                         rule.rhs == item.rhs;
-                                                }));
-          actionTable[currentStateID][terminalToID[item.lookahead]] =
-              Action(Action::REDUCE, ruleId);
+          int ruleId = ruleIndex[Rule(item.lhs, item.rhs)];
+          setAction(currentStateID, terminalToID[item.lookahead],
+                    Action(Action::REDUCE, ruleId));
         }
         if (item.lhs == grammar[0].lhs && item.lookahead == "END_OF_FILE") {
           // Accept state for the start production
-          actionTable[currentStateID][terminalToID["END_OF_FILE"]] =
-              Action(Action::ACCEPT);
+          setAction(currentStateID, terminalToID["END_OF_FILE"],
+                    Action(Action::ACCEPT));
         }
       }
     }
   }
+}
 
-  printParseTable();
+// Writes content to path unless the file already holds exactly that, so
+// files that include it are not rebuilt for nothing
+void writeIfChanged(const string &path, const string &content) {
+  ifstream existing(path, ios::binary);
+  if (existing.is_open()) {
+    stringstream buffer;
+    buffer << existing.rdbuf();
+    if (buffer.str() == content) {
+      return;
+    }
+  }
+  ofstream file(path, ios::binary | ios::trunc);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open file: " + path);
+  }
+  file << content;
+  if (!file) {
+    throw runtime_error("Failed to write file: " + path);
+  }
+}
+
+static const char *CLOSURE_CACHE_HEADER = "parser_generator closure cache 1";
+
+uint64_t fnv1a(const string &text, uint64_t hash = 14695981039346656037ull) {
+  for (unsigned char c : text) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// Hash of everything a closure depends on when a symbol follows the dot:
+// whether it is a terminal, the hashes of its rules, and its FOLLOW set,
+// which supplies the lookaheads
+map<string, uint64_t> symbolSignatures() {
+  map<string, uint64_t> signatures;
+  for (const auto &terminal : terminals) {
+    signatures[terminal] = fnv1a("terminal " + terminal);
+  }
+  for (const auto &nonTerminal : nonTerminals) {
+    vector<uint64_t> ruleHashes;
+    for (const auto &rule : grammar) {
+      if (rule.lhs == nonTerminal) {
+        ruleHashes.push_back(fnv1a(rule.lhs + " -> " + join(rule.rhs)));
+      }
+    }
+    sort(ruleHashes.begin(), ruleHashes.end());
+    string text = "nonterminal " + nonTerminal;
+    for (uint64_t hash : ruleHashes) {
+      text += " " + to_string(hash);
+    }
+    text += " |";
+    for (const auto &lookahead : followSets[nonTerminal]) {
+      text += " " + lookahead;
+    }
+    signatures[nonTerminal] = fnv1a(text);
+  }
+  return signatures;
+}
+
+// Symbols right after a dot: the ones the closure expanded or checked
+set<string> expandedSymbols(const set<LR1Item> &items) {
+  set<string> symbols;
+  for (const auto &item : items) {
+    if (item.dotPosition < item.rhs.size()) {
+      symbols.insert(item.rhs[item.dotPosition]);
+    }
+  }
+  return symbols;
+}
+
+// Loads the closures of a previous run that are unaffected by grammar
+// changes since. A missing or unreadable cache just means no reuse.
+void loadClosureCache(const string &path) {
+  ifstream file(path);
+  string line;
+  if (!getline(file, line) || line != CLOSURE_CACHE_HEADER) {
+    return;
+  }
+
+  map<string, uint64_t> current = symbolSignatures();
+  set<string> changed;
+  auto readItems = [&](size_t count, set<LR1Item> &items) {
+    for (size_t i = 0; i < count && getline(file, line); ++i) {
+      istringstream fields(line);
+      string lhs, lookahead, symbol;
+      int dot;
+      fields >> lhs >> dot >> lookahead;
+      vector<string> rhs;
+      while (fields >> symbol) {
+        rhs.push_back(symbol);
+      }
+      items.insert(LR1Item(lhs, rhs, dot, lookahead));
+    }
+  };
+
+  while (getline(file, line)) {
+    istringstream fields(line);
+    string kind;
+    fields >> kind;
+    if (kind == "signature") {
+      string symbol;
+      uint64_t signature;
+      fields >> symbol >> signature;
+      if (!current.count(symbol) || current[symbol] != signature) {
+        changed.insert(symbol);
+      }
+    } else if (kind == "closure") {
+      size_t kernelCount, itemCount;
+      fields >> kernelCount >> itemCount;
+      set<LR1Item> kernel, items;
+      readItems(kernelCount, kernel);
+      readItems(itemCount, items);
+      bool valid = true;
+      for (const auto &symbol : expandedSymbols(items)) {
+        valid = valid && current.count(symbol) && !changed.count(symbol);
+      }
+      if (valid) {
+        closureCache.emplace(kernel, items);
+      }
+    }
+  }
+}
+
+void saveClosureCache(const string &path) {
+  ostringstream out;
+  auto writeItems = [&](const set<LR1Item> &items) {
+    for (const auto &item : items) {
+      out << item.lhs << " " << item.dotPosition << " " << item.lookahead;
+      for (const auto &symbol : item.rhs) {
+        out << " " << symbol;
+      }
+      out << "\n";
+    }
+  };
+  out << CLOSURE_CACHE_HEADER << "\n";
+  for (const auto &[symbol, signature] : symbolSignatures()) {
+    out << "signature " << symbol << " " << signature << "\n";
+  }
+  for (const auto &[kernel, items] : closures) {
+    out << "closure " << kernel.size() << " " << items.size() << "\n";
+    writeItems(kernel);
+    writeItems(items);
+  }
+  writeIfChanged(path, out.str());
+}
+
+// Generator state number of each state in the emitted tables. BFS order
+// unless renumberStates() reordered them; written to parser.h so profiles of
+// a renumbered parser still map back to the states here.
+vector<int> generatorStates;
+
+// Reads the per-state visit counts of a profile written by
+// parser --profile-json, indexed by generator state number
+vector<uint64_t> readStateProfile(const string &path) {
+  ifstream file(path);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open file: " + path);
+  }
+  stringstream buffer;
+  buffer << file.rdbuf();
+  string text = buffer.str();
+
+  auto readArray = [&](const string &key) {
+    vector<uint64_t> values;
+    size_t position = text.find("\"" + key + "\"");
+    if (position == string::npos) {
+      return values;
+    }
+    size_t end = text.find(']', position);
+    if (text.find('[', position) > end) {
+      throw runtime_error("Malformed " + key + " in profile: " + path);
+    }
+    stringstream numbers(text.substr(position, end - position));
+    numbers.ignore(end, '[');
+    uint64_t value;
+    while (numbers >> value) {
+      values.push_back(value);
+      numbers.ignore(1, ',');
+    }
+    return values;
+  };
+
+  vector<uint64_t> visits = readArray("stateVisits");
+  vector<uint64_t> ids = readArray("generatorStates");
+  if (visits.size() != actionTable.size() ||
+      (!ids.empty() && ids.size() != visits.size())) {
+    throw runtime_error("Profile does not match the grammar's " +
+                        to_string(actionTable.size()) + " states: " + path);
+  }
+  if (ids.empty()) {
+    return visits;
+  }
+  vector<uint64_t> byGeneratorState(visits.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (ids[i] >= visits.size()) {
+      throw runtime_error("Profile does not match the grammar: " + path);
+    }
+    byGeneratorState[ids[i]] = visits[i];
+  }
+  return byGeneratorState;
+}
+
+// Renumbers states so the visited ones come first, hottest first, and a hot
+// state is followed by its hottest successor where that successor is nearly
+// as hot. Consecutive states share cache lines of the action table, so
+// states visited one after another end up next to each other. State 0 stays
+// the start state.
+void renumberStates(const vector<uint64_t> &visits) {
+  size_t count = actionTable.size();
+  vector<int> hot;
+  for (size_t state = 1; state < count; ++state) {
+    if (visits[state] > 0) {
+      hot.push_back(state);
+    }
+  }
+  stable_sort(hot.begin(), hot.end(),
+              [&](int a, int b) { return visits[a] > visits[b]; });
+
+  vector<int> order = {0};
+  vector<bool> placed(count, false);
+  placed[0] = true;
+  size_t nextHot = 0;
+  while (true) {
+    // Follow the chain of hot successors, or start a new one at the hottest
+    // state left
+    int last = order.back();
+    int best = -1;
+    auto consider = [&](int target) {
+      if (target > 0 && !placed[target] && visits[target] > 0 &&
+          visits[target] * 2 >= visits[last] &&
+          (best == -1 || visits[target] > visits[best])) {
+        best = target;
+      }
+    };
+    for (const auto &action : actionTable[last]) {
+      if (action.actionType == Action::SHIFT) {
+        consider(action.stateOrRule);
+      }
+    }
+    for (const auto &entry : gotoTable[last]) {
+      consider(entry.state);
+    }
+    while (best == -1 && nextHot < hot.size()) {
+      if (!placed[hot[nextHot]]) {
+        best = hot[nextHot];
+      }
+      ++nextHot;
+    }
+    if (best == -1) {
+      break;
+    }
+    placed[best] = true;
+    order.push_back(best);
+  }
+  for (size_t state = 1; state < count; ++state) {
+    if (!placed[state]) {
+      order.push_back(state);
+    }
+  }
+
+  vector<int> newNumber(count);
+  for (size_t i = 0; i < count; ++i) {
+    newNumber[order[i]] = i;
+  }
+  vector<vector<Action>> newActions(count);
+  vector<vector<Goto>> newGotos(count);
+  vector<set<LR1Item>> newStates(count);
+  vector<int> newGeneratorStates(count);
+  for (size_t state = 0; state < count; ++state) {
+    int target = newNumber[state];
+    newActions[target] = actionTable[state];
+    for (auto &action : newActions[target]) {
+      if (action.actionType == Action::SHIFT) {
+        action.stateOrRule = newNumber[action.stateOrRule];
+      }
+    }
+    newGotos[target] = gotoTable[state];
+    for (auto &entry : newGotos[target]) {
+      if (entry.state != -1) {
+        entry.state = newNumber[entry.state];
+      }
+    }
+    newStates[target] = states[state];
+    newGeneratorStates[target] = generatorStates[state];
+  }
+  map<pair<int, int>, vector<Action>> newConflicts;
+  for (auto [cell, actions] : conflicts) {
+    for (auto &action : actions) {
+      if (action.actionType == Action::SHIFT) {
+        action.stateOrRule = newNumber[action.stateOrRule];
+      }
+    }
+    newConflicts[{newNumber[cell.first], cell.second}] = actions;
+  }
+  actionTable = move(newActions);
+  gotoTable = move(newGotos);
+  conflicts = move(newConflicts);
+  states = move(newStates);
+  generatorStates = move(newGeneratorStates);
 }
 
 // camelCase to uppercase SNAKE_CASE
@@ -380,21 +739,21 @@ std::string toUpperSnakeCase(std::string input) {
 }
 
 void generateCSTHeaderFile() {
-  ofstream headerFile("cst.h");
-  if (!headerFile.is_open()) {
-
-  }
+  ostringstream headerFile;
   headerFile << "#ifndef CST_H\n";
   headerFile << "#define CST_H\n\n";
+  headerFile << "#include <charconv>\n";
+  headerFile << "#include <cstdint>\n";
   headerFile << "#include <vector>\n";
-  headerFile << "#include <string>\n\n";
+  headerFile << "#include <string>\n";
+  headerFile << "#include <string_view>\n\n";
   headerFile << "enum CSTNodeType {\n";
   for (const auto &nonTerminal : nonTerminals) {
     headerFile << "    " << toUpperSnakeCase(nonTerminal) << ",\n";
   }
   headerFile << "    TERMINAL,\n";
   headerFile << "};\n\n";
-  headerFile << "std::string cstNodeTypeToString(CSTNodeType type) {\n";
+  headerFile << "inline std::string cstNodeTypeToString(CSTNodeType type) {\n";
   headerFile << "    switch (type) {\n";
   for (const auto &nonTerminal : nonTerminals) {
     headerFile << "        case " << toUpperSnakeCase(nonTerminal) << ":\n";
@@ -413,16 +772,10 @@ void generateCSTHeaderFile() {
   headerFile << "    std::vector<CSTNode *> children;\n";
   headerFile << "    CSTNode() {}\n";
   headerFile << "    CSTNode(CSTNodeType type) : type(type) {}\n";
+  headerFile << "    virtual ~CSTNode() = default;\n";
   headerFile << "    void addChild(CSTNode *child) {\n";
   headerFile << "        child->parent = this;\n";
   headerFile << "        children.push_back(child);\n";
-  headerFile << "    }\n\n";
-  headerFile << "    virtual void print(int level = 0) const {\n";
-  headerFile << "        for (int i = 0; i < level; ++i) std::cout << \"  \";  // Indentation for depth\n";
-  headerFile << "        std::cout << cstNodeTypeToString(type) << std::endl;\n";
-  headerFile << "        for (auto child : children) {\n";
-  headerFile << "            child->print(level + 1);\n";
-  headerFile << "        }\n";
   headerFile << "    }\n";
   headerFile << "};\n\n";
   headerFile << "enum CSTTerminalNodeType {\n";
@@ -430,7 +783,7 @@ void generateCSTHeaderFile() {
     headerFile << "    " << terminal << ",\n";
   }
   headerFile << "};\n\n";
-  headerFile << "std::string cstTerminalNodeTypeToString(CSTTerminalNodeType type) {\n";
+  headerFile << "inline std::string cstTerminalNodeTypeToString(CSTTerminalNodeType type) {\n";
   headerFile << "    switch (type) {\n";
   for (const auto &terminal : terminals) {
     headerFile << "        case " << toUpperSnakeCase(terminal) << ":\n";
@@ -443,153 +796,295 @@ void generateCSTHeaderFile() {
   headerFile << "class CSTTerminalNode : public CSTNode {\n";
   headerFile << "public:\n";
   headerFile << "    CSTTerminalNodeType type;\n";
-  headerFile << "    std::string value;\n";
-  headerFile << "    CSTTerminalNode(CSTTerminalNodeType type, const std::string &value) : CSTNode(CSTNodeType::TERMINAL), type(type), value(value) {}\n";
-  headerFile << "    CSTTerminalNode(CSTTerminalNodeType type) : CSTTerminalNode(type, \"\") {}\n";
-  headerFile << "    void print(int level = 0) const override  {\n";
-  headerFile << "        for (int i = 0; i < level; ++i) std::cout << \"  \";  // Indentation for depth\n";
-  headerFile << "        std::cout << cstTerminalNodeTypeToString(type);\n";
-  headerFile << "        if (!value.empty()) {\n";
-  headerFile << "            std::cout << \": \" << value;\n";
+  headerFile << "    std::string_view value;  // Spelling owned by the SymbolTable the lexer interned it into\n";
+  headerFile << "    uint32_t symbol;  // Interned symbol ID of value, or UINT32_MAX if the terminal has no value\n";
+  headerFile << "    bool hasInteger = false;  // The lexer decoded a literal into integer and kept no spelling\n";
+  headerFile << "    int64_t integer = 0;\n";
+  headerFile << "    size_t offset = 0;  // Of the terminal's first byte in the source, for diagnostics\n";
+  headerFile << "    CSTTerminalNode(CSTTerminalNodeType type, std::string_view value, uint32_t symbol) : CSTNode(CSTNodeType::TERMINAL), type(type), value(value), symbol(symbol) {}\n";
+  headerFile << "    CSTTerminalNode(CSTTerminalNodeType type) : CSTTerminalNode(type, \"\", UINT32_MAX) {}\n";
+  headerFile << "    CSTTerminalNode(CSTTerminalNodeType type, int64_t integer) : CSTTerminalNode(type) {\n";
+  headerFile << "        hasInteger = true;\n";
+  headerFile << "        this->integer = integer;\n";
+  headerFile << "    }\n\n";
+  headerFile << "    // value, or a decoded integer formatted into buffer\n";
+  headerFile << "    std::string_view spelling(char (&buffer)[24]) const {\n";
+  headerFile << "        if (!hasInteger) {\n";
+  headerFile << "            return value;\n";
   headerFile << "        }\n";
-  headerFile << "        std::cout << std::endl;\n";
+  headerFile << "        return std::string_view(buffer, std::to_chars(buffer, buffer + sizeof(buffer), integer).ptr - buffer);\n";
   headerFile << "    }\n";
   headerFile << "};\n\n";
   headerFile << "#endif";
+
+  writeIfChanged("cst.h", headerFile.str());
+}
+
+// Packs an action into the int16_t encoding LRDriver reads (lr_driver.h)
+int16_t packAction(const Action &action) {
+  switch (action.actionType) {
+  case Action::SHIFT:
+    if (action.stateOrRule > INT16_MAX) {
+      throw runtime_error("Too many states for 16-bit parse tables");
+    }
+    return action.stateOrRule;
+  case Action::REDUCE:
+    if (action.stateOrRule >= INT16_MAX) {
+      throw runtime_error("Too many rules for 16-bit parse tables");
+    }
+    return -action.stateOrRule - 1;
+  case Action::ACCEPT:
+    return INT16_MIN;
+  case Action::NONE:
+  default:
+    return 0;
+  }
+}
+
+// Rewrites $$ and $1..$n in an action to the variables of the generated
+// reduce function, leaving string and character literals alone
+string translateAction(const Rule &rule, int ruleIndex) {
+  const string &action = rule.action;
+  string result;
+  for (size_t i = 0; i < action.size();) {
+    char c = action[i];
+    if (c == '"' || c == '\'') {
+      size_t end = i + 1;
+      while (end < action.size() && action[end] != c) {
+        end += action[end] == '\\' ? 2 : 1;
+      }
+      end = min(end + 1, action.size());
+      result += action.substr(i, end - i);
+      i = end;
+    } else if (c == '$' && i + 1 < action.size() && action[i + 1] == '$') {
+      result += "result";
+      i += 2;
+    } else if (c == '$' && i + 1 < action.size() && isdigit(action[i + 1])) {
+      size_t end = i + 1;
+      while (end < action.size() && isdigit(action[end])) {
+        end++;
+      }
+      size_t position = stoul(action.substr(i + 1, end - i - 1));
+      if (position < 1 || position > rule.rhs.size()) {
+        throw runtime_error("Rule " + to_string(ruleIndex) + " (" + rule.lhs + " -> " + join(rule.rhs) +
+                            ") has no symbol $" + to_string(position));
+      }
+      result += "rhs[" + to_string(position - 1) + "]";
+      i = end;
+    } else {
+      result += c;
+      i++;
+    }
+  }
+  return result;
+}
+
+// Function to write the semantic actions of the grammar, if it has any, as
+// a reduce function over a user-chosen Value type. Rules without an action
+// pass their first value through ($$ = $1).
+void generateSemanticActions(ostream &headerFile) {
+  if (none_of(grammar.begin(), grammar.end(), [](const Rule &rule) { return !rule.action.empty(); })) {
+    return;
+  }
+  headerFile << "#include <span>\n\n";
+  headerFile << "// Semantic actions from the grammar file, for LRDriver's CallbackBuilder.\n";
+  headerFile << "// $$ became result and $n became rhs[n - 1].\n";
+  headerFile << "template <typename Value>\n";
+  headerFile << "struct ParserActions {\n";
+  headerFile << "    static Value reduce(int rule, std::span<Value> rhs) {\n";
+  headerFile << "        Value result{};\n";
+  headerFile << "        switch (rule) {\n";
+  for (size_t i = 0; i < grammar.size(); ++i) {
+    if (grammar[i].action.empty()) {
+      continue;
+    }
+    headerFile << "            case " << i << ": {  // " << grammar[i].lhs << " -> " << join(grammar[i].rhs) << "\n";
+    headerFile << "                " << translateAction(grammar[i], i) << "\n";
+    headerFile << "                break;\n";
+    headerFile << "            }\n";
+  }
+  headerFile << "            default:\n";
+  headerFile << "                if (!rhs.empty()) result = rhs[0];\n";
+  headerFile << "                break;\n";
+  headerFile << "        }\n";
+  headerFile << "        return result;\n";
+  headerFile << "    }\n";
+  headerFile << "};\n\n";
 }
 
 // Function to generate the header file
 void generateParserHeaderFile() {
-  ofstream headerFile("parser.h");
+  ostringstream headerFile;
 
   // Write the header guards
   headerFile << "#ifndef PARSER_H\n";
   headerFile << "#define PARSER_H\n\n";
 
   // Write the includes
-  headerFile << "#include <algorithm>\n";
-  headerFile << "#include <string>\n";
-  headerFile << "#include <map>\n";
-  headerFile << "#include <vector>\n\n";
-
-  // Write the Action struct definition
-  headerFile << "struct Action {\n";
-  headerFile << "    enum ActionType {\n";
-  headerFile << "        SHIFT,\n";
-  headerFile << "        REDUCE,\n";
-  headerFile << "        ACCEPT,\n";
-  headerFile << "        NONE\n";
-  headerFile << "    };\n";
-  headerFile << "    ActionType actionType;\n";
-  headerFile
-      << "    int stateOrRule; // For SHIFT: state; For REDUCE: rule index\n";
-  headerFile << "};\n\n";
-
-  // Write the Goto struct definition
-  headerFile << "struct Goto {\n";
-  headerFile << "    int state;  // The state to go to for a non-terminal\n";
-  headerFile << "};\n\n";
-
-  // Write the Rule struct definition
-  headerFile << "struct Rule {\n";
-  headerFile << "    std::string lhs;  // Left-hand side of the rule\n";
-  headerFile << "    std::vector<std::string> rhs;  // Right-hand side of the "
-                "rule (sequence of symbols)\n";
-  headerFile << "};\n\n";
+  headerFile << "#include <cstdint>\n\n";
 
-  // Write terminal and non-terminal mappings
+  // Write the table dimensions
   headerFile << "static const int NUM_TERMINALS = " << terminals.size()
              << ";\n";
   headerFile << "static const int NUM_NON_TERMINALS = " << nonTerminals.size()
              << ";\n";
   headerFile << "static const int NUM_STATES = " << actionTable.size()
-             << ";\n\n";
+             << ";\n";
+  headerFile << "static const int NUM_RULES = " << grammar.size() << ";\n\n";
 
-  // Terminal and non-terminal mappings
-  headerFile << "static const std::map<std::string, int> terminalToID = {\n";
-  for (const auto &entry : terminalToID) {
-    headerFile << "    {\"" << entry.first << "\", " << entry.second << "},\n";
+  // Write the tables as a traits struct for LRDriver
+  headerFile << "// Tables for LRDriver (lr_driver.h). Actions: 0 is an error, "
+                "n > 0 shifts to\n";
+  headerFile << "// state n, n < 0 reduces by rule -n - 1 and INT16_MIN "
+                "accepts.\n";
+  headerFile << "struct ParserTables {\n";
+
+  // Terminal names and rules, for tracing
+  headerFile << "    static constexpr const char *terminalNames[NUM_TERMINALS] = {\n";
+  for (const auto &terminal : terminals) {
+    headerFile << "        \"" << toUpperSnakeCase(terminal) << "\",\n";
   }
-  headerFile << "};\n\n";
+  headerFile << "    };\n\n";
+
+  // The error token drivers shift when they recover, or -1 without one
+  headerFile << "    static constexpr int errorTerminal = "
+             << (terminalToID.count("ERROR") ? terminalToID["ERROR"] : -1) << ";\n";
+  headerFile << "    static constexpr int endOfFileTerminal = "
+             << terminalToID["END_OF_FILE"] << ";\n\n";
 
-  headerFile << "static const std::map<std::string, int> nonTerminalToID = {\n";
-  for (const auto &entry : nonTerminalToID) {
-    headerFile << "    {\"" << entry.first << "\", " << entry.second << "},\n";
+  headerFile << "    static constexpr const char *nonTerminalNames[NUM_NON_TERMINALS] = {\n";
+  for (const auto &nonTerminal : nonTerminals) {
+    headerFile << "        \"" << nonTerminal << "\",\n";
+  }
+  headerFile << "    };\n\n";
+
+  headerFile << "    static constexpr const char *ruleText[NUM_RULES] = {\n";
+  for (const auto &rule : grammar) {
+    headerFile << "        \"" << rule.lhs << " -> " << join(rule.rhs) << "\",\n";
+  }
+  headerFile << "    };\n\n";
+
+  // Write the length and left-hand side of every rule
+  headerFile << "    static constexpr uint16_t ruleLength[NUM_RULES] = { ";
+  for (const auto &rule : grammar) {
+    headerFile << rule.rhs.size() << ", ";
+  }
+  headerFile << "};\n";
+  headerFile << "    static constexpr uint16_t ruleLhs[NUM_RULES] = { ";
+  for (const auto &rule : grammar) {
+    headerFile << nonTerminalToID[rule.lhs] << ", ";
   }
   headerFile << "};\n\n";
 
-  // Write the action table
-  headerFile
-      << "static const std::vector<std::vector<Action>> actionTable = {\n";
+  // Write the action table. In GLR mode a conflicted cell holds
+  // INT16_MIN + 1 + k for the k-th conflict instead of one of its actions.
+  vector<int16_t> conflictActions;
+  vector<size_t> conflictStart = {0};
+  headerFile << "    static constexpr int16_t actions[NUM_STATES][NUM_TERMINALS] = {\n";
   for (size_t i = 0; i < actionTable.size(); ++i) {
-    headerFile << "    { ";
+    headerFile << "        { ";
     for (size_t j = 0; j < actionTable[i].size(); ++j) {
-      headerFile << "{Action::"
-                 << (actionTable[i][j].actionType == Action::SHIFT    ? "SHIFT"
-                     : actionTable[i][j].actionType == Action::REDUCE ? "REDUCE"
-                     : actionTable[i][j].actionType == Action::ACCEPT ? "ACCEPT"
-                                                                      : "NONE")
-                 << ", " << actionTable[i][j].stateOrRule << "}, ";
+      auto conflict = conflicts.find({(int)i, (int)j});
+      if (glrMode && conflict != conflicts.end()) {
+        int code = INT16_MIN + (int)conflictStart.size();
+        if (code >= -(int)grammar.size()) {
+          throw runtime_error("Too many conflicts for 16-bit parse tables");
+        }
+        headerFile << code << ", ";
+        for (const auto &action : conflict->second) {
+          conflictActions.push_back(packAction(action));
+        }
+        conflictStart.push_back(conflictActions.size());
+      } else {
+        headerFile << packAction(actionTable[i][j]) << ", ";
+      }
     }
     headerFile << "},\n";
   }
+  headerFile << "    };\n\n";
+
+  // Write the actions of conflicted cells, for GLRDriver (glr_driver.h)
+  headerFile << "    static constexpr int conflictCount = "
+             << conflictStart.size() - 1 << ";\n";
+  headerFile << "    static constexpr uint16_t conflictStart[conflictCount + 1] = { ";
+  for (size_t start : conflictStart) {
+    headerFile << start << ", ";
+  }
+  headerFile << "};\n";
+  if (conflictActions.empty()) {
+    conflictActions.push_back(0); // Arrays cannot be empty
+  }
+  headerFile << "    static constexpr int16_t conflictActions[" << conflictActions.size()
+             << "] = { ";
+  for (int16_t action : conflictActions) {
+    headerFile << action << ", ";
+  }
   headerFile << "};\n\n";
 
   // Write the goto table
-  headerFile << "static const std::vector<std::vector<Goto>> gotoTable = {\n";
+  headerFile << "    static constexpr int16_t gotos[NUM_STATES][NUM_NON_TERMINALS] = {\n";
   for (size_t i = 0; i < gotoTable.size(); ++i) {
-    headerFile << "    { ";
+    headerFile << "        { ";
     for (size_t j = 0; j < gotoTable[i].size(); ++j) {
-      headerFile << "{" << gotoTable[i][j].state << "}, ";
+      headerFile << gotoTable[i][j].state << ", ";
     }
     headerFile << "},\n";
   }
-  headerFile << "};\n\n";
+  headerFile << "    };\n\n";
 
-  // Write the number of symbols per rule
-  headerFile << "static const std::map<int, int> ruleSymbolCount = {\n";
-  for (size_t i = 0; i < grammar.size(); ++i) {
-    headerFile << "    {" << i << ", " << grammar[i].rhs.size() << "},\n";
+  // Write the generator's number for each state, for mapping profiles back
+  headerFile << "    static constexpr uint16_t generatorStates[NUM_STATES] = { ";
+  for (int state : generatorStates) {
+    headerFile << state << ", ";
   }
+  headerFile << "};\n";
   headerFile << "};\n\n";
 
-  // Write the grammar (rules)
-  headerFile << "static const std::vector<Rule> grammar = {\n";
-  for (size_t i = 0; i < grammar.size(); ++i) {
-    headerFile << "    {\"" << grammar[i].lhs << "\", {";
-    for (size_t j = 0; j < grammar[i].rhs.size(); ++j) {
-      headerFile << "\"" << grammar[i].rhs[j] << "\"";
-      if (j < grammar[i].rhs.size() - 1) {
-        headerFile << ", ";
-      }
-    }
-    headerFile << "}},\n";
-  }
-  headerFile << "};\n\n";
+  generateSemanticActions(headerFile);
 
   // Close the header guard
   headerFile << "#endif // PARSER_H\n";
 
-  // Close the file
-  headerFile.close();
+  writeIfChanged("parser.h", headerFile.str());
 }
 
-#include "grammar_parser.h"
-
-void traversePreOrder(GrammarParser::CSTNode* node, std::function<void(GrammarParser::CSTNode*)> callback) {
-  callback(node);
-  for (GrammarParser::CSTNode* child : node->children) {
-    traversePreOrder(child, callback);
+// Function to write the tables in the binary format drivers load at runtime
+void generateBinaryParseTables(const string &path) {
+  ParseTableSource source;
+  source.terminals = terminals;
+  source.nonTerminals = nonTerminals;
+  source.endOfFileTerminal = terminalToID["END_OF_FILE"];
+  for (const auto &rule : grammar) {
+    ParseTableSource::Rule tableRule;
+    tableRule.lhs = nonTerminalToID[rule.lhs];
+    for (const auto &symbol : rule.rhs) {
+      tableRule.rhs.push_back(terminalToID.count(symbol)
+                                  ? terminalToID[symbol]
+                                  : terminals.size() + nonTerminalToID[symbol]);
+    }
+    source.rules.push_back(tableRule);
   }
-}
-
-void traversePostOrder(GrammarParser::CSTNode* node, std::function<void(GrammarParser::CSTNode*)> callback) {
-    for (GrammarParser::CSTNode* child : node->children) {
-        traversePostOrder(child, callback);
+  for (size_t state = 0; state < actionTable.size(); ++state) {
+    vector<uint16_t> actions;
+    for (const auto &action : actionTable[state]) {
+      ParseActionKind kind = action.actionType == Action::SHIFT    ? PARSE_SHIFT
+                             : action.actionType == Action::REDUCE ? PARSE_REDUCE
+                             : action.actionType == Action::ACCEPT ? PARSE_ACCEPT
+                                                                   : PARSE_ERROR;
+      actions.push_back(encodeParseAction(kind, max(action.stateOrRule, 0)));
     }
-    callback(node);
+    source.actions.push_back(actions);
+    vector<int32_t> gotos;
+    for (const auto &entry : gotoTable[state]) {
+      gotos.push_back(entry.state);
+    }
+    source.gotos.push_back(gotos);
+  }
+  writeParseTables(path, source);
 }
 
+#include "grammar_parser.h"
+
 class ASTNode {
 public:
   ASTNode() {}
@@ -601,80 +1096,116 @@ class ASTRuleNode : public ASTNode {
 public:
   string symbol;
   vector<vector<string>> options;
+  vector<string> actions; // One per option, empty if it has none
 };
 
 class ASTGrammarNode : public ASTNode {
 public:
   vector<ASTRuleNode *> rules;
+  vector<string> nonTerminals; // In order of definition
+  vector<string> terminals;    // In order of first use
 };
 
-vector<GrammarParser::CSTNode *> collectRules(GrammarParser::CSTNode *cstRoot) {
-  vector<GrammarParser::CSTNode *> rules;
-  traversePreOrder(cstRoot, [&](GrammarParser::CSTNode *node) {
-    if (node->type == GrammarParser::CSTNodeType::RULE) {
-      rules.push_back(node);
+// Builds the grammar AST in a single iterative pre-order walk of the CST,
+// numbering symbols as it goes. Pre-order visits rules, options and
+// identifiers in source order because the lists are left-recursive.
+ASTGrammarNode *cstToAst(GrammarParser::CSTNode *cstRoot) {
+  using namespace GrammarParser;
+  ASTGrammarNode *astRoot = new ASTGrammarNode();
+  unordered_set<string> definedSymbols;
+  unordered_set<string> usedSymbols;
+  vector<string> usedInOrder;
+  ASTRuleNode *currentRule = nullptr;
+
+  vector<CSTNode *> pending = {cstRoot};
+  while (!pending.empty()) {
+    CSTNode *node = pending.back();
+    pending.pop_back();
+    size_t firstChild = 0;
+
+    if (node->type == CSTNodeType::RULE) {
+      currentRule = new ASTRuleNode();
+      currentRule->symbol = static_cast<CSTTerminalNode *>(node->children[0])->value;
+      astRoot->rules.push_back(currentRule);
+      if (definedSymbols.insert(currentRule->symbol).second) {
+        astRoot->nonTerminals.push_back(currentRule->symbol);
+      }
+      firstChild = 1; // The rule name is not part of any option
+    } else if (node->type == CSTNodeType::OPTION) {
+      currentRule->options.emplace_back();
+      currentRule->actions.emplace_back();
+    } else if (node->type == CSTNodeType::TERMINAL) {
+      CSTTerminalNode *terminal = static_cast<CSTTerminalNode *>(node);
+      if (terminal->type == CSTTerminalNodeType::IDENTIFIER) {
+        string symbol(terminal->value);
+        currentRule->options.back().push_back(symbol);
+        if (usedSymbols.insert(symbol).second) {
+          usedInOrder.push_back(symbol);
+        }
+      } else if (terminal->type == CSTTerminalNodeType::ACTION) {
+        currentRule->actions.back() = terminal->value;
+      }
     }
-  });
-  return rules;
-}
 
-vector<GrammarParser::CSTNode *> collectOptions(GrammarParser::CSTNode *cstRoot) {
-  vector<GrammarParser::CSTNode *> options;
-  traversePreOrder(cstRoot, [&](GrammarParser::CSTNode *node) {
-    if (node->type == GrammarParser::CSTNodeType::OPTION) {
-      options.push_back(node);
+    for (size_t i = node->children.size(); i-- > firstChild;) {
+      pending.push_back(node->children[i]);
     }
-  });
-  return options;
-}
-
-vector<string> collectIdentifiers(GrammarParser::CSTNode *cstRoot) {
-  vector<string> identifiers;
-  traversePreOrder(cstRoot, [&](GrammarParser::CSTNode *node) {
-    if (node->type == GrammarParser::CSTNodeType::TERMINAL) {
-      GrammarParser::CSTTerminalNode *terminal = dynamic_cast<GrammarParser::CSTTerminalNode *>(node);
-      GrammarParser::CSTTerminalNodeType type = terminal->type;
-      if (type == GrammarParser::CSTTerminalNodeType::IDENTIFIER) {
-        identifiers.push_back(terminal->value);
-      }
-    }
-  });
-  return identifiers;
-}
+  }
 
-ASTGrammarNode *cstToAst(GrammarParser::CSTNode *cstRoot) {
-  ASTGrammarNode *astRoot = new ASTGrammarNode();
-  auto cstRules = collectRules(cstRoot);
-  for (auto cstRule : cstRules) {
-    ASTRuleNode *astRule = new ASTRuleNode();
-    astRule->symbol = dynamic_cast<GrammarParser::CSTTerminalNode *>(cstRule->children[0])->value;
-    auto cstOptions = collectOptions(cstRule);
-    for (auto cstOption : cstOptions) {
-      auto identifiers = collectIdentifiers(cstOption);
-      astRule->options.push_back(identifiers);
+  for (const string &symbol : usedInOrder) {
+    if (!definedSymbols.count(symbol)) {
+      astRoot->terminals.push_back(symbol);
     }
-    astRoot->rules.push_back(astRule);
   }
   return astRoot;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc < 2) {
-      cerr << "Usage: " << argv[0] << " <input_file>" << endl;
+  string tablesPath;
+  string profilePath;
+  string cachePath;
+  bool quiet = false;
+  bool validArguments = argc >= 2;
+  for (int i = 2; validArguments && i < argc; ++i) {
+    string option = argv[i];
+    if (option == "--glr") {
+      glrMode = true;
+    } else if (option == "--tables" && i + 1 < argc) {
+      tablesPath = argv[++i];
+    } else if (option == "--profile" && i + 1 < argc) {
+      profilePath = argv[++i];
+    } else if (option == "--cache" && i + 1 < argc) {
+      cachePath = argv[++i];
+    } else if (option == "--quiet") {
+      quiet = true;
+    } else {
+      validArguments = false;
+    }
+  }
+  if (!validArguments) {
+      cerr << "Usage: " << argv[0] << " <input_file> [--glr] [--quiet] [--tables <output_file>]\n"
+           << "    [--profile <profile.json>] [--cache <cache_file>]" << endl;
       return 1;
   }
 
+  // Everything on stdout is a progress log, so quiet just drops it
+  if (quiet) {
+    cout.setstate(ios::badbit);
+  }
+
   string inputString = GrammarParser::readFile(argv[1]);
-  vector<GrammarParser::CSTNode *> input = GrammarParser::tokenize(inputString);
 
   try {
+      vector<GrammarParser::CSTNode *> input = GrammarParser::tokenize(inputString);
       GrammarParser::CSTNode* cstRoot = GrammarParser::parse(input);
       ASTGrammarNode *astRoot = cstToAst(cstRoot);
       for (auto rule : astRoot->rules) {
-        for (auto option : rule->options) {
-          grammar.push_back(Rule(rule->symbol, option));
+        for (size_t i = 0; i < rule->options.size(); ++i) {
+          grammar.push_back(Rule(rule->symbol, rule->options[i], rule->actions[i]));
         }
       }
+      nonTerminals = astRoot->nonTerminals;
+      terminals = astRoot->terminals;
   } catch (const runtime_error& e) {
       cerr << "Error: " << e.what() << endl;
       return 1;
@@ -689,23 +1220,13 @@ int main(int argc, char* argv[]) {
     cout << endl;
   }
 
-  // Populate the terminal and non-terminal symbols
-
-  for (const auto &rule : grammar) {
-    if (find(nonTerminals.begin(), nonTerminals.end(), rule.lhs) == nonTerminals.end()) {
-      nonTerminals.push_back(rule.lhs);
-    }
-  }
-
-  for (const auto &rule : grammar) {
-    for (const auto &symbol : rule.rhs) {
-      if (find(nonTerminals.begin(), nonTerminals.end(), symbol) == nonTerminals.end() &&
-          find(terminals.begin(), terminals.end(), symbol) == terminals.end()) {
-        terminals.push_back(symbol);
-      }
-    }
+  // ERROR is the error token of recovery rules, which the lexer never
+  // produces. It goes after every terminal the lexer does produce, so that
+  // adding recovery rules to a grammar leaves their IDs alone.
+  auto errorTerminal = find(terminals.begin(), terminals.end(), "ERROR");
+  if (errorTerminal != terminals.end()) {
+    rotate(errorTerminal, errorTerminal + 1, terminals.end());
   }
-
   terminals.push_back("END_OF_FILE");
 
   for (int i = 0; i < terminals.size(); ++i) {
@@ -721,9 +1242,47 @@ int main(int argc, char* argv[]) {
     computeFollow(nonTerminal);
   }
 
+  if (!cachePath.empty()) {
+    loadClosureCache(cachePath);
+  }
   generateLR1ParseTable();
-  generateParserHeaderFile();
-  generateCSTHeaderFile();
+  if (!cachePath.empty()) {
+    cout << "Reused " << reusedClosures << " of " << closures.size()
+         << " closures from " << cachePath << endl;
+  }
+  for (size_t state = 0; state < actionTable.size(); ++state) {
+    generatorStates.push_back(state);
+  }
+
+  // Lay the tables out by how often a corpus visits each state
+  if (!profilePath.empty()) {
+    try {
+      renumberStates(readStateProfile(profilePath));
+    } catch (const runtime_error& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    }
+  }
+  printParseTable();
+  if (!conflicts.empty() && !glrMode) {
+    cerr << "Warning: " << conflicts.size()
+         << " conflicts resolved to the last action of each cell; use --glr "
+            "to keep them all" << endl;
+  }
+
+  try {
+    generateParserHeaderFile();
+    generateCSTHeaderFile();
+    if (!cachePath.empty()) {
+      saveClosureCache(cachePath);
+    }
+    if (!tablesPath.empty()) {
+      generateBinaryParseTables(tablesPath);
+    }
+  } catch (const runtime_error& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+  }
 
   return 0;
 }
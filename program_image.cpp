@@ -0,0 +1,354 @@
+#include "program_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+
+uint64_t hashSource(string_view source) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : source) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+namespace {
+
+// Accumulates the image in memory, section by section
+class ImageBuilder {
+public:
+    vector<char> bytes = vector<char>(sizeof(ProgramImageHeader));
+
+    template <typename T>
+    uint32_t append(const vector<T> &items) {
+        bytes.resize((bytes.size() + 7) & ~size_t(7));
+        uint32_t offset = bytes.size();
+        const char *data = reinterpret_cast<const char *>(items.data());
+        bytes.insert(bytes.end(), data, data + items.size() * sizeof(T));
+        return offset;
+    }
+};
+
+// Flattens expressions in post-order so children always precede their
+// parents. Shared nodes of a value-numbered DAG are written once.
+class NodeFlattener {
+public:
+    vector<ImageNode> nodes;
+
+    uint32_t flatten(const ASTExpression *root) {
+        vector<pair<const ASTExpression *, bool>> pending = {{root, false}};
+        while (!pending.empty()) {
+            auto [expression, childrenDone] = pending.back();
+            pending.pop_back();
+            if (indices.count(expression)) {
+                continue;
+            }
+            ImageNode node = {expression->kind, BinaryOperator::ADD, 0, 0, 0};
+            if (expression->kind == ASTNodeKind::INT_LITERAL) {
+                node.a = (uint32_t) static_cast<const ASTIntLiteral *>(expression)->value;
+            } else if (expression->kind == ASTNodeKind::VAR_REF) {
+                node.a = static_cast<const ASTVarRef *>(expression)->name;
+                node.b = static_cast<const ASTVarRef *>(expression)->paramIndex;
+            } else {
+                auto *binaryOp = static_cast<const ASTBinaryOp *>(expression);
+                if (!childrenDone) {
+                    pending.push_back({expression, true});
+                    pending.push_back({binaryOp->rhs, false});
+                    pending.push_back({binaryOp->lhs, false});
+                    continue;
+                }
+                node.op = binaryOp->op;
+                node.a = indices.at(binaryOp->lhs);
+                node.b = indices.at(binaryOp->rhs);
+            }
+            indices[expression] = nodes.size();
+            nodes.push_back(node);
+        }
+        return indices.at(root);
+    }
+
+private:
+    unordered_map<const ASTExpression *, uint32_t> indices;
+};
+
+}  // namespace
+
+vector<char> buildProgramImage(uint64_t sourceHash, const ASTProgram *program, const BytecodeProgram *bytecode,
+                               const SymbolTable &symbols) {
+    vector<ImageString> strings;
+    vector<char> stringBytes;
+    for (uint32_t symbol = 0; symbol < symbols.size(); ++symbol) {
+        string_view name = symbols.name(symbol);
+        strings.push_back({(uint32_t)stringBytes.size(), (uint32_t)name.size()});
+        stringBytes.insert(stringBytes.end(), name.begin(), name.end());
+    }
+
+    vector<ImageFunction> functions;
+    vector<uint32_t> indices;
+    NodeFlattener flattener;
+    vector<Instruction> instructions;
+    vector<int32_t> constants;
+    for (size_t i = 0; i < program->functions.size(); ++i) {
+        const ASTFunction *function = program->functions[i];
+        ImageFunction record = {};
+        record.name = function->name;
+        record.paramCount = function->params.size();
+        record.paramsIndex = indices.size();
+        for (const ASTParam &param : function->params) {
+            indices.push_back(param.name);
+        }
+        record.statementCount = function->statements.size();
+        record.statementsIndex = indices.size();
+        for (const ASTReturn *statement : function->statements) {
+            indices.push_back(flattener.flatten(statement->value));
+        }
+        if (bytecode != nullptr) {
+            const BytecodeFunction &compiled = bytecode->functions[i];
+            record.registerCount = compiled.registerCount;
+            record.codeCount = compiled.code.size();
+            record.codeIndex = instructions.size();
+            instructions.insert(instructions.end(), compiled.code.begin(), compiled.code.end());
+            record.constantCount = compiled.constants.size();
+            record.constantsIndex = constants.size();
+            constants.insert(constants.end(), compiled.constants.begin(), compiled.constants.end());
+        }
+        functions.push_back(record);
+    }
+
+    ImageBuilder builder;
+    ProgramImageHeader header = {};
+    memcpy(header.magic, PROGRAM_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_IMAGE_VERSION;
+    header.flags = bytecode != nullptr ? PROGRAM_IMAGE_HAS_BYTECODE : 0;
+    header.sourceHash = sourceHash;
+    header.stringCount = strings.size();
+    header.stringsOffset = builder.append(strings);
+    header.stringBytesSize = stringBytes.size();
+    header.stringBytesOffset = builder.append(stringBytes);
+    header.functionCount = functions.size();
+    header.functionsOffset = builder.append(functions);
+    header.indexCount = indices.size();
+    header.indicesOffset = builder.append(indices);
+    header.nodeCount = flattener.nodes.size();
+    header.nodesOffset = builder.append(flattener.nodes);
+    header.instructionCount = instructions.size();
+    header.instructionsOffset = builder.append(instructions);
+    header.constantCount = constants.size();
+    header.constantsOffset = builder.append(constants);
+    header.fileSize = builder.bytes.size();
+    memcpy(builder.bytes.data(), &header, sizeof(header));
+    return move(builder.bytes);
+}
+
+void writeProgramImage(const string &path, uint64_t sourceHash, const ASTProgram *program,
+                       const BytecodeProgram *bytecode, const SymbolTable &symbols) {
+    vector<char> bytes = buildProgramImage(sourceHash, program, bytecode, symbols);
+
+    // Readers may map the file at any moment, so never expose a partial image
+    string temporaryPath = path + ".tmp." + to_string(getpid());
+    {
+        ofstream file(temporaryPath, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            throw runtime_error("Failed to open file: " + temporaryPath);
+        }
+        file.write(bytes.data(), bytes.size());
+        if (!file) {
+            throw runtime_error("Failed to write file: " + temporaryPath);
+        }
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        throw runtime_error("Failed to rename " + temporaryPath + " to " + path);
+    }
+}
+
+MappedProgram::MappedProgram(const string &path) : file(path) {
+    if (!file.contains<ProgramImageHeader>(0, 1)) {
+        throw runtime_error("Not a program image: " + path);
+    }
+
+    // Everything below is trusted by the accessors, so check it all up front
+    const ProgramImageHeader &h = header();
+    bool valid = memcmp(h.magic, PROGRAM_IMAGE_MAGIC, sizeof(h.magic)) == 0 &&
+                 h.version == PROGRAM_IMAGE_VERSION && h.fileSize == file.size() &&
+                 file.contains<ImageString>(h.stringsOffset, h.stringCount) &&
+                 file.contains<char>(h.stringBytesOffset, h.stringBytesSize) &&
+                 file.contains<ImageFunction>(h.functionsOffset, h.functionCount) &&
+                 file.contains<uint32_t>(h.indicesOffset, h.indexCount) &&
+                 file.contains<ImageNode>(h.nodesOffset, h.nodeCount) &&
+                 file.contains<Instruction>(h.instructionsOffset, h.instructionCount) &&
+                 file.contains<int32_t>(h.constantsOffset, h.constantCount);
+    for (uint32_t i = 0; valid && i < h.stringCount; ++i) {
+        const ImageString &s = section<ImageString>(h.stringsOffset, h.stringCount)[i];
+        valid = (uint64_t)s.offset + s.length <= h.stringBytesSize;
+    }
+    // Operands come before the nodes using them, so one pass in order also
+    // finds how many parameters each subtree refers to
+    vector<uint64_t> paramsNeeded(valid ? h.nodeCount : 0);
+    for (uint32_t i = 0; valid && i < h.nodeCount; ++i) {
+        const ImageNode &node = nodes()[i];
+        if (node.kind == ASTNodeKind::BINARY_OP) {
+            valid = node.a < i && node.b < i && (uint8_t)node.op <= (uint8_t)BinaryOperator::DIVIDE;
+            paramsNeeded[i] = valid ? max(paramsNeeded[node.a], paramsNeeded[node.b]) : 0;
+        } else if (node.kind == ASTNodeKind::VAR_REF) {
+            valid = node.a < h.stringCount;
+            paramsNeeded[i] = (uint64_t)node.b + 1;
+        } else {
+            valid = node.kind == ASTNodeKind::INT_LITERAL;
+        }
+    }
+    for (const ImageFunction &function : valid ? functions() : span<const ImageFunction>()) {
+        valid = valid && function.name < h.stringCount &&
+                (uint64_t)function.paramsIndex + function.paramCount <= h.indexCount &&
+                (uint64_t)function.statementsIndex + function.statementCount <= h.indexCount &&
+                (uint64_t)function.codeIndex + function.codeCount <= h.instructionCount &&
+                (uint64_t)function.constantsIndex + function.constantCount <= h.constantCount;
+        for (uint32_t i = 0; valid && i < function.statementCount; ++i) {
+            uint32_t root = indices()[function.statementsIndex + i];
+            valid = root < h.nodeCount && paramsNeeded[root] <= function.paramCount;
+        }
+        for (uint32_t i = 0; valid && i < function.paramCount; ++i) {
+            valid = indices()[function.paramsIndex + i] < h.stringCount;
+        }
+
+        // The VM, the JIT and batch run the code without bounds checks: every
+        // register must lie in the function's file, which holds the
+        // parameters and constants, and the code must end by returning.
+        // Parameters and constants are read-only, so only the temporaries
+        // after them may be written; RETURN has no destination
+        if (valid && (h.flags & PROGRAM_IMAGE_HAS_BYTECODE)) {
+            span<const Instruction> code = section<Instruction>(h.instructionsOffset, h.instructionCount)
+                                               .subspan(function.codeIndex, function.codeCount);
+            valid = function.registerCount <= MAX_REGISTERS &&
+                    (uint64_t)function.paramCount + function.constantCount <= function.registerCount &&
+                    !code.empty() && code.back().opcode == OP_RETURN;
+            uint32_t firstTemporary = function.paramCount + function.constantCount;
+            for (size_t i = 0; valid && i < code.size(); ++i) {
+                const Instruction &instruction = code[i];
+                valid = instruction.opcode < OPCODE_COUNT && instruction.dst < function.registerCount &&
+                        (instruction.opcode == OP_RETURN || instruction.dst >= firstTemporary) &&
+                        instruction.a < function.registerCount && instruction.b < function.registerCount;
+            }
+        }
+    }
+    if (!valid) {
+        throw runtime_error("Not a valid program image: " + path);
+    }
+}
+
+string_view MappedProgram::symbolName(uint32_t index) const {
+    const ImageString &s = section<ImageString>(header().stringsOffset, header().stringCount)[index];
+    return {file.at<char>(header().stringBytesOffset + s.offset), s.length};
+}
+
+void MappedProgram::loadSymbols(SymbolTable &symbols) const {
+    if (symbols.size() != 0) {
+        throw runtime_error("Program images must be loaded into an empty symbol table");
+    }
+    for (uint32_t i = 0; i < header().stringCount; ++i) {
+        symbols.intern(symbolName(i));
+    }
+}
+
+ASTProgram *MappedProgram::loadAST(Arena &arena) const {
+    span<const ImageNode> flatNodes = nodes();
+    span<ASTExpression *> expressions = arena.makeArray<ASTExpression *>(flatNodes.size());
+    for (size_t i = 0; i < flatNodes.size(); ++i) {
+        const ImageNode &node = flatNodes[i];
+        if (node.kind == ASTNodeKind::INT_LITERAL) {
+            auto *literal = arena.make<ASTIntLiteral>();
+            literal->value = (int32_t)node.a;
+            expressions[i] = literal;
+        } else if (node.kind == ASTNodeKind::VAR_REF) {
+            auto *varRef = arena.make<ASTVarRef>();
+            varRef->name = node.a;
+            varRef->paramIndex = node.b;
+            expressions[i] = varRef;
+        } else {
+            auto *binaryOp = arena.make<ASTBinaryOp>();
+            binaryOp->op = node.op;
+            binaryOp->lhs = expressions[node.a];
+            binaryOp->rhs = expressions[node.b];
+            expressions[i] = binaryOp;
+        }
+        expressions[i]->kind = node.kind;
+    }
+
+    ASTProgram *program = arena.make<ASTProgram>();
+    program->functions = arena.makeArray<ASTFunction *>(header().functionCount);
+    for (size_t i = 0; i < functions().size(); ++i) {
+        const ImageFunction &record = functions()[i];
+        ASTFunction *function = arena.make<ASTFunction>();
+        function->kind = ASTNodeKind::FUNCTION;
+        function->name = record.name;
+        function->params = arena.makeArray<ASTParam>(record.paramCount);
+        for (uint32_t p = 0; p < record.paramCount; ++p) {
+            function->params[p].kind = ASTNodeKind::PARAM;
+            function->params[p].name = indices()[record.paramsIndex + p];
+        }
+        function->statements = arena.makeArray<ASTReturn *>(record.statementCount);
+        for (uint32_t s = 0; s < record.statementCount; ++s) {
+            ASTReturn *statement = arena.make<ASTReturn>();
+            statement->kind = ASTNodeKind::RETURN;
+            statement->value = expressions[indices()[record.statementsIndex + s]];
+            function->statements[s] = statement;
+        }
+        program->functions[i] = function;
+    }
+    return program;
+}
+
+BytecodeProgram MappedProgram::loadBytecode(const SymbolTable &symbols) const {
+    if (!hasBytecode()) {
+        throw runtime_error("Program image has no bytecode");
+    }
+    span<const Instruction> instructions = section<Instruction>(header().instructionsOffset, header().instructionCount);
+    span<const int32_t> constants = section<int32_t>(header().constantsOffset, header().constantCount);
+
+    BytecodeProgram program;
+    program.symbols = &symbols;
+    for (const ImageFunction &record : functions()) {
+        BytecodeFunction function;
+        function.name = record.name;
+        function.paramCount = record.paramCount;
+        function.registerCount = record.registerCount;
+        function.code = instructions.subspan(record.codeIndex, record.codeCount);
+        function.constants = constants.subspan(record.constantsIndex, record.constantCount);
+        program.functionBySymbol[record.name] = program.functions.size();
+        program.functions.push_back(function);
+    }
+    return program;
+}
+
+string programImagePath(const string &cacheDirectory, uint64_t sourceHash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.scriptimg", (unsigned long long)sourceHash);
+    return cacheDirectory + "/" + name;
+}
+
+unique_ptr<MappedProgram> loadCachedProgram(const string &cacheDirectory, string_view source) {
+    uint64_t sourceHash = hashSource(source);
+    string path = programImagePath(cacheDirectory, sourceHash);
+    if (access(path.c_str(), R_OK) != 0) {
+        return nullptr;
+    }
+    try {
+        auto program = make_unique<MappedProgram>(path);
+        if (program->header().sourceHash != sourceHash) {
+            return nullptr;
+        }
+        return program;
+    } catch (const runtime_error &) {
+        // A stale or damaged entry is a cache miss; it gets rewritten
+        return nullptr;
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef PROGRAM_IMAGE_H
+#define PROGRAM_IMAGE_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "ast.h"
+#include "bytecode.h"
+#include "mapped_file.h"
+#include "symbol_table.h"
+
+// On-disk image of a parsed and optionally compiled program. Every reference
+// inside the file is an index or a byte offset from the start of the file, so
+// an image can be mapped read-only and used in place without relocation.
+//
+// Layout: ProgramImageHeader, then the sections it points to, each aligned
+// to 8 bytes. String i in the string table is symbol ID i.
+
+static const char PROGRAM_IMAGE_MAGIC[8] = {'S', 'C', 'R', 'I', 'P', 'T', 'I', 'M'};
+static const uint32_t PROGRAM_IMAGE_VERSION = 1;
+
+enum ProgramImageFlags : uint32_t {
+    PROGRAM_IMAGE_HAS_BYTECODE = 1,
+};
+
+struct ProgramImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t sourceHash;  // hashSource() of the script the image was built from
+    uint64_t fileSize;
+    uint32_t stringCount, stringsOffset;  // ImageString[stringCount]
+    uint32_t stringBytesSize, stringBytesOffset;
+    uint32_t functionCount, functionsOffset;  // ImageFunction[functionCount]
+    uint32_t indexCount, indicesOffset;  // uint32_t[indexCount], referenced by functions
+    uint32_t nodeCount, nodesOffset;  // ImageNode[nodeCount]
+    uint32_t instructionCount, instructionsOffset;  // Instruction[instructionCount]
+    uint32_t constantCount, constantsOffset;  // int32_t[constantCount]
+};
+
+struct ImageString {
+    uint32_t offset;  // Into the string bytes section
+    uint32_t length;
+};
+
+// Flat AST node. For INT_LITERAL a is the value, for VAR_REF a is the name
+// and b the parameter index, for BINARY_OP a and b are node indices.
+struct ImageNode {
+    ASTNodeKind kind;
+    BinaryOperator op;
+    uint16_t reserved;
+    uint32_t a;
+    uint32_t b;
+};
+
+struct ImageFunction {
+    uint32_t name;
+    uint32_t paramCount, paramsIndex;  // Parameter names at indices[paramsIndex...]
+    uint32_t statementCount, statementsIndex;  // Return value node indices at indices[statementsIndex...]
+    uint32_t registerCount;
+    uint32_t codeCount, codeIndex;  // Into the instructions section
+    uint32_t constantCount, constantsIndex;  // Into the constants section
+};
+
+// 64-bit FNV-1a of the script source, used as the cache key
+uint64_t hashSource(std::string_view source);
+
+// Serializes the image in memory, exactly as writeProgramImage() stores it
+std::vector<char> buildProgramImage(uint64_t sourceHash, const ASTProgram *program, const BytecodeProgram *bytecode,
+                                    const SymbolTable &symbols);
+
+// Writes the image to path atomically (write to a temporary file, then
+// rename). bytecode may be null for a parse-only image. Throws runtime_error
+// on I/O failure.
+void writeProgramImage(const std::string &path, uint64_t sourceHash, const ASTProgram *program,
+                       const BytecodeProgram *bytecode, const SymbolTable &symbols);
+
+// A read-only mapping of a program image.
+class MappedProgram {
+public:
+    // Throws runtime_error if the file cannot be mapped or is not a valid
+    // image of the current version
+    explicit MappedProgram(const std::string &path);
+
+    const ProgramImageHeader &header() const { return *file.at<ProgramImageHeader>(0); }
+    bool hasBytecode() const { return header().flags & PROGRAM_IMAGE_HAS_BYTECODE; }
+
+    std::string_view symbolName(uint32_t index) const;
+    std::span<const ImageFunction> functions() const { return section<ImageFunction>(header().functionsOffset, header().functionCount); }
+    std::span<const uint32_t> indices() const { return section<uint32_t>(header().indicesOffset, header().indexCount); }
+    std::span<const ImageNode> nodes() const { return section<ImageNode>(header().nodesOffset, header().nodeCount); }
+
+    // Interns the string table into symbols, which must be empty so that
+    // symbol IDs match string indices
+    void loadSymbols(SymbolTable &symbols) const;
+
+    // Rebuilds the AST; names are symbol IDs in the table filled by loadSymbols()
+    ASTProgram *loadAST(Arena &arena) const;
+
+    // Bytecode whose code and constants point straight into the mapping, so it
+    // must not outlive this object. Throws runtime_error if the image has none.
+    BytecodeProgram loadBytecode(const SymbolTable &symbols) const;
+
+private:
+    template <typename T>
+    std::span<const T> section(uint32_t offset, uint32_t count) const {
+        return {file.at<T>(offset), count};
+    }
+
+    MappedFile file;
+};
+
+// Path of the image for a source hash inside a cache directory
+std::string programImagePath(const std::string &cacheDirectory, uint64_t sourceHash);
+
+// Maps the cached image for source, or returns null if there is no usable
+// one (missing, corrupt, from another version, or for different source).
+std::unique_ptr<MappedProgram> loadCachedProgram(const std::string &cacheDirectory, std::string_view source);
+
+#endif // PROGRAM_IMAGE_H
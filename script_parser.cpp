@@ -0,0 +1,643 @@
+#include "script_parser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include "cst_writer.h"
+#include "spsc_ring.h"
+
+using namespace std;
+
+static int terminalOf(CSTNode *const &node) {
+    return static_cast<CSTTerminalNode *>(node)->type;
+}
+
+static SyntaxError syntaxErrorAt(const char *terminalName, size_t offset) {
+    return SyntaxError(string("Unexpected ") + terminalName, offset);
+}
+
+static SyntaxError syntaxErrorAt(const LRSyntaxError &error, size_t offset) {
+    return syntaxErrorAt(error.terminalName, offset);
+}
+
+// Least input per thread for tokenizeParallel(), below which starting a
+// thread costs more than it saves
+static const size_t PARALLEL_LEX_CHUNK = 1 << 20;
+
+// The LR(1) parser function
+CSTNode* parse(const vector<CSTNode *>& input, bool verbose, ParseProfile *profile) {
+    CSTTerminalNode endOfFile(CSTTerminalNodeType::END_OF_FILE);
+    VectorLexer<CSTNode *, terminalOf> lexer(input, &endOfFile);
+    CSTBuilder<CSTNode, CSTNodeType> builder;
+    LRDriver<ParserTables, decltype(lexer), decltype(builder)> driver(lexer, builder);
+    driver.setProfile(profile);
+    try {
+        return verbose ? driver.parse<true>() : driver.parse<false>();
+    } catch (const LRSyntaxError &error) {
+        size_t offending = lexer.position() == 0 ? 0 : lexer.position() - 1;
+        throw syntaxErrorAt(error, offending < input.size() ? static_cast<CSTTerminalNode *>(input[offending])->offset : 0);
+    }
+}
+
+// CSTBuilder that recovers from syntax errors for parseRecovering(): each
+// error is recorded and becomes an ERROR terminal at the offending token
+class RecoveringCSTBuilder : public CSTBuilder<CSTNode, CSTNodeType> {
+public:
+    explicit RecoveringCSTBuilder(vector<SyntaxError> &errors) : errors(errors) {}
+
+    Node error(Node token, int terminal, span<Node> popped) {
+        size_t offset = static_cast<CSTTerminalNode *>(token)->offset;
+        errors.push_back(syntaxErrorAt(ParserTables::terminalNames[terminal], offset));
+        CSTTerminalNode *error = new CSTTerminalNode(CSTTerminalNodeType::ERROR);
+        error->offset = offset;
+        error->children.reserve(popped.size());
+        for (Node node : popped) {
+            error->addChild(node);
+        }
+        return error;
+    }
+    void skip(Node error, Node token) { error->addChild(token); }
+
+private:
+    vector<SyntaxError> &errors;
+};
+
+CSTNode *parseRecovering(const vector<CSTNode *> &input, vector<SyntaxError> &errors, bool verbose, ParseProfile *profile) {
+    CSTTerminalNode endOfFile(CSTTerminalNodeType::END_OF_FILE);
+    VectorLexer<CSTNode *, terminalOf> lexer(input, &endOfFile);
+    RecoveringCSTBuilder builder(errors);
+    LRDriver<ParserTables, decltype(lexer), decltype(builder)> driver(lexer, builder);
+    driver.setProfile(profile);
+    try {
+        return verbose ? driver.parse<true>() : driver.parse<false>();
+    } catch (const LRSyntaxError &error) {
+        size_t offending = lexer.position() == 0 ? 0 : lexer.position() - 1;
+        throw syntaxErrorAt(error, offending < input.size() ? static_cast<CSTTerminalNode *>(input[offending])->offset : 0);
+    }
+}
+
+SPPFNode *parseForest(const vector<CSTNode *>& input, Arena &arena) {
+    CSTTerminalNode endOfFile(CSTTerminalNodeType::END_OF_FILE);
+    VectorLexer<CSTNode *, terminalOf> lexer(input, &endOfFile);
+    GLRDriver<ParserTables, decltype(lexer)> driver(lexer, arena);
+    try {
+        return driver.parse();
+    } catch (const LRSyntaxError &error) {
+        throw syntaxErrorAt(error, static_cast<CSTTerminalNode *>(driver.tokens().back())->offset);
+    }
+}
+
+// Decodes the digits at input[index], eight at a time: each step loads eight
+// bytes as one little-endian word, counts the leading digits from a per-byte
+// mask and converts them with three multiplies that combine adjacent digits
+// into pairs, fours and eights. Advances index past the digits. Returns
+// false if the value is above INT32_MAX.
+static bool lexNumber(string_view input, size_t &index, int64_t &result) {
+    const uint64_t ones = 0x0101010101010101;
+    uint64_t value = 0;
+    bool overflow = false;
+    while (true) {
+        uint64_t word = 0;
+        memcpy(&word, input.data() + index, min<size_t>(8, input.size() - index));  // Zero padding is not a digit
+
+        // A byte is a digit if subtracting '0' leaves 0-9: no high nibble,
+        // and adding 6 does not carry into one
+        uint64_t digits = word - '0' * ones;
+        uint64_t notDigit = (digits | (digits + 6 * ones)) & (0xF0 * ones);
+        size_t count = notDigit ? countr_zero(notDigit) / 8 : 8;
+        if (count == 0) {
+            break;
+        }
+        index += count;
+
+        // Leading zero digits pad a short run out to eight
+        if (count < 8) {
+            digits <<= 8 * (8 - count);
+        }
+        digits = (digits & 0x0F0F0F0F0F0F0F0F) * (10 * 256 + 1) >> 8;
+        digits = (digits & 0x00FF00FF00FF00FF) * (100 * 65536 + 1) >> 16;
+        digits = (digits & 0x0000FFFF0000FFFF) * (10000 * 4294967296 + 1) >> 32;
+
+        static const uint64_t powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+        value = value * powers[count] + digits;
+        // value stays below 2^31 * 10^8 + 10^8 here, far from wrapping
+        if (value > INT32_MAX) {
+            overflow = true;
+            value = 0;
+        }
+        if (count < 8) {
+            break;
+        }
+    }
+    result = (int64_t)value;
+    return !overflow;
+}
+
+ScriptToken ScriptLexer::next() {
+    while (index < input.size()) {
+        char c = input[index];
+        if (isspace((unsigned char)c)) {
+            index++;  // Skip whitespace
+            continue;
+        }
+        tokenStart = index;
+
+        CSTTerminalNodeType punctuator;
+        switch (c) {
+            case ',': punctuator = CSTTerminalNodeType::COMMA; break;
+            case ';': punctuator = CSTTerminalNodeType::SEMICOLON; break;
+            case '{': punctuator = CSTTerminalNodeType::LEFT_BRACE; break;
+            case '}': punctuator = CSTTerminalNodeType::RIGHT_BRACE; break;
+            case '(': punctuator = CSTTerminalNodeType::LEFT_PARENTHESIS; break;
+            case ')': punctuator = CSTTerminalNodeType::RIGHT_PARENTHESIS; break;
+            case '+': punctuator = CSTTerminalNodeType::PLUS; break;
+            case '-': punctuator = CSTTerminalNodeType::MINUS; break;
+            case '*': punctuator = CSTTerminalNodeType::ASTERISK; break;
+            case '/': punctuator = CSTTerminalNodeType::SLASH; break;
+            default: punctuator = CSTTerminalNodeType::END_OF_FILE; break;
+        }
+        if (punctuator != CSTTerminalNodeType::END_OF_FILE) {
+            return {punctuator, input.substr(index++, 1)};
+        }
+
+        // Handle keywords and IDENTIFIER
+        size_t start = index;
+        if (isalpha((unsigned char)c) || c == '_') {
+            while (index < input.size() && (isalnum((unsigned char)input[index]) || input[index] == '_')) {
+                index++;
+            }
+            string_view word = input.substr(start, index - start);
+            if (word == "return") {
+                return {CSTTerminalNodeType::RETURN, word};
+            }
+            if (word == "int") {
+                return {CSTTerminalNodeType::INT, word};
+            }
+            return {CSTTerminalNodeType::IDENTIFIER, word};
+        }
+
+        // Handle NUMBER
+        if (isdigit((unsigned char)c)) {
+            int64_t value;
+            bool inRange = lexNumber(input, index, value);
+            string_view digits = input.substr(start, index - start);
+            if (!inRange) {
+                throw SyntaxError("Integer literal out of range: " + string(digits), base + start);
+            }
+            return {CSTTerminalNodeType::NUMBER, digits, value};
+        }
+
+        // Any other byte starts no token; it is shown as hex unless visible
+        char shown[8] = {c};
+        if (!isgraph((unsigned char)c)) {
+            snprintf(shown, sizeof(shown), "0x%02X", (unsigned char)c);
+        }
+        throw SyntaxError(string("Unrecognized character: ") + shown, base + index);
+    }
+    tokenStart = input.size();
+    return {CSTTerminalNodeType::END_OF_FILE, string_view()};
+}
+
+static bool isWordCharacter(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// IDENTIFIER spellings are interned into symbols, so each distinct name is
+// stored once no matter how often it appears. A NUMBER keeps only its value.
+static void setTerminal(CSTTerminalNode &terminal, const ScriptToken &token, size_t offset, SymbolTable &symbols) {
+    terminal.type = token.type;
+    terminal.hasInteger = token.type == CSTTerminalNodeType::NUMBER;
+    terminal.integer = token.integer;
+    if (token.type == CSTTerminalNodeType::IDENTIFIER) {
+        terminal.symbol = symbols.intern(token.text);
+        terminal.value = symbols.name(terminal.symbol);
+    } else {
+        terminal.symbol = UINT32_MAX;
+        terminal.value = string_view();
+    }
+    terminal.offset = offset;
+}
+
+static CSTNode *makeTerminal(const ScriptToken &token, size_t offset, SymbolTable &symbols) {
+    CSTTerminalNode *terminal = new CSTTerminalNode(token.type);
+    setTerminal(*terminal, token, offset, symbols);
+    return terminal;
+}
+
+// Tokenizer function that returns CSTNode instances for recognized tokens
+vector<CSTNode*> tokenize(const string& input, SymbolTable& symbols, bool verbose) {
+    vector<CSTNode*> tokens;
+    ScriptLexer lexer(input);
+    try {
+        while (true) {
+            ScriptToken token = lexer.next();
+            tokens.push_back(makeTerminal(token, lexer.tokenOffset(), symbols));
+            if (token.type == CSTTerminalNodeType::END_OF_FILE) {
+                break;
+            }
+        }
+    } catch (const SyntaxError &) {
+        for (CSTNode *token : tokens) {
+            delete token;
+        }
+        throw;
+    }
+
+    // For debugging: print tokens
+    if (verbose) {
+        cout.flush();  // The writer goes to stdout directly, after any earlier trace
+        CSTWriter writer(stdout);
+        for (const auto& token : tokens) {
+            writer.write(token, CSTFormat::TREE);
+        }
+    }
+
+    return tokens;
+}
+
+ScriptPushParser::ScriptPushParser(SymbolTable &symbols) : symbols(symbols), automaton(builder) {}
+
+void ScriptPushParser::reset() {
+    automaton.reset();
+    terminals.clear();
+    partialWord.clear();
+    fed = 0;
+}
+
+void ScriptPushParser::push(const ScriptToken &token, size_t offset) {
+    CSTNode *terminal = makeTerminal(token, offset, symbols);
+    terminals.push_back(terminal);
+    try {
+        automaton.push(terminal, token.type);
+    } catch (const LRSyntaxError &error) {
+        throw syntaxErrorAt(error, offset);
+    }
+}
+
+void ScriptPushParser::feed(string_view chunk) {
+    // A word left over from the previous chunk ends at the first character
+    // that cannot continue it, which may be in a later chunk still
+    if (!partialWord.empty()) {
+        size_t length = 0;
+        while (length < chunk.size() && isWordCharacter(chunk[length])) {
+            ++length;
+        }
+        partialWord.append(chunk.substr(0, length));
+        fed += length;
+        if (length == chunk.size()) {
+            return;
+        }
+        ScriptLexer lexer(partialWord, partialWordOffset);
+        for (ScriptToken token = lexer.next(); token.type != CSTTerminalNodeType::END_OF_FILE; token = lexer.next()) {
+            push(token, lexer.tokenOffset());
+        }
+        partialWord.clear();
+        chunk.remove_prefix(length);
+    }
+
+    ScriptLexer lexer(chunk, fed);
+    fed += chunk.size();
+    for (ScriptToken token = lexer.next(); token.type != CSTTerminalNodeType::END_OF_FILE; token = lexer.next()) {
+        if (lexer.position() == chunk.size() && isWordCharacter(chunk.back())) {
+            partialWord.assign(token.text);
+            partialWordOffset = lexer.tokenOffset();
+            return;
+        }
+        push(token, lexer.tokenOffset());
+    }
+}
+
+CSTNode *ScriptPushParser::finish() {
+    ScriptLexer lexer(partialWord, partialWordOffset);
+    for (ScriptToken token = lexer.next(); token.type != CSTTerminalNodeType::END_OF_FILE; token = lexer.next()) {
+        push(token, lexer.tokenOffset());
+    }
+    partialWord.clear();
+    push({CSTTerminalNodeType::END_OF_FILE, string_view()}, fed);
+    return automaton.result();
+}
+
+vector<CSTNode*> tokenizeParallel(const string& input, SymbolTable& symbols, size_t threadCount) {
+    size_t chunkCount = clamp<size_t>(input.size() / PARALLEL_LEX_CHUNK, 1, max<size_t>(threadCount, 1));
+    if (chunkCount == 1) {
+        return tokenize(input, symbols, false);
+    }
+
+    // Every token is a single character or a run of word characters, so a
+    // chunk that starts on a character that cannot continue a word never
+    // starts inside a token
+    vector<size_t> bounds = {0};
+    for (size_t i = 1; i < chunkCount; ++i) {
+        size_t bound = max(input.size() * i / chunkCount, bounds.back());
+        while (bound < input.size() && isWordCharacter(input[bound])) {
+            ++bound;
+        }
+        bounds.push_back(bound);
+    }
+    bounds.push_back(input.size());
+
+    // Each chunk interns into a table of its own, merged afterwards
+    struct Chunk {
+        vector<CSTNode *> tokens;
+        SymbolTable symbols;
+        exception_ptr error;
+    };
+    vector<Chunk> chunks(chunkCount);
+    auto lexChunk = [&](size_t i) {
+        try {
+            ScriptLexer lexer(string_view(input).substr(bounds[i], bounds[i + 1] - bounds[i]), bounds[i]);
+            while (true) {
+                ScriptToken token = lexer.next();
+                if (token.type == CSTTerminalNodeType::END_OF_FILE && i + 1 < chunkCount) {
+                    break;
+                }
+                chunks[i].tokens.push_back(makeTerminal(token, lexer.tokenOffset(), chunks[i].symbols));
+                if (token.type == CSTTerminalNodeType::END_OF_FILE) {
+                    break;
+                }
+            }
+        } catch (...) {
+            chunks[i].error = current_exception();
+        }
+    };
+    vector<thread> threads;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        threads.emplace_back(lexChunk, i);
+    }
+    lexChunk(0);
+    for (thread &t : threads) {
+        t.join();
+    }
+    threads.clear();
+    // The first error in the source is the one a sequential pass would throw
+    for (Chunk &chunk : chunks) {
+        if (chunk.error) {
+            for (Chunk &other : chunks) {
+                for (CSTNode *token : other.tokens) {
+                    delete token;
+                }
+            }
+            rethrow_exception(chunk.error);
+        }
+    }
+
+    // Interning chunk by chunk, each in its own first-seen order, hands out
+    // the IDs of one sequential pass
+    vector<vector<uint32_t>> symbolMaps(chunkCount);
+    vector<size_t> starts = {0};
+    for (size_t i = 0; i < chunkCount; ++i) {
+        for (uint32_t local = 0; local < chunks[i].symbols.size(); ++local) {
+            symbolMaps[i].push_back(symbols.intern(chunks[i].symbols.name(local)));
+        }
+        starts.push_back(starts.back() + chunks[i].tokens.size());
+    }
+
+    vector<CSTNode *> tokens(starts.back());
+    auto mergeChunk = [&](size_t i) {
+        for (size_t j = 0; j < chunks[i].tokens.size(); ++j) {
+            auto *terminal = static_cast<CSTTerminalNode *>(chunks[i].tokens[j]);
+            if (terminal->symbol != UINT32_MAX) {
+                terminal->symbol = symbolMaps[i][terminal->symbol];
+                terminal->value = symbols.name(terminal->symbol);
+            }
+            tokens[starts[i] + j] = terminal;
+        }
+    };
+    for (size_t i = 1; i < chunkCount; ++i) {
+        threads.emplace_back(mergeChunk, i);
+    }
+    mergeChunk(0);
+    for (thread &t : threads) {
+        t.join();
+    }
+    return tokens;
+}
+
+using TokenRing = SPSCRing<CSTNode *, 4096>;
+static const size_t TOKEN_BATCH = TokenRing::CACHE_LINE_ITEMS;
+
+// Sends count tokens, waiting while the ring is full. Returns false if the
+// consumer gave up first.
+static bool sendTokens(TokenRing &ring, CSTNode *const *batch, size_t count, const atomic<bool> &cancelled) {
+    size_t sent = 0;
+    while (sent < count) {
+        size_t n = ring.tryPush(batch + sent, count - sent);
+        sent += n;
+        if (n == 0) {
+            if (cancelled.load(memory_order_relaxed)) {
+                return false;
+            }
+            this_thread::yield();
+        }
+    }
+    return true;
+}
+
+// The consumer end of the pipeline as a lexer for LRDriver. A null token is
+// the producer's signal that lexing failed with lexerError.
+class RingLexer {
+public:
+    using Token = CSTNode *;
+
+    RingLexer(TokenRing &ring, vector<CSTNode *> &tokens, const exception_ptr &lexerError)
+        : ring(ring), tokens(tokens), lexerError(lexerError) {}
+
+    Token next() {
+        if (index == count) {
+            while ((count = ring.tryPop(batch, TOKEN_BATCH)) == 0) {
+                this_thread::yield();
+            }
+            index = 0;
+        }
+        CSTNode *token = batch[index++];
+        if (token == nullptr) {
+            rethrow_exception(lexerError);
+        }
+        tokens.push_back(token);
+        return token;
+    }
+    static int terminal(const Token &token) { return terminalOf(token); }
+
+    // Deletes the tokens received but not returned yet
+    void discard() {
+        for (; index < count; ++index) {
+            delete batch[index];
+        }
+    }
+
+private:
+    TokenRing &ring;
+    vector<CSTNode *> &tokens;
+    const exception_ptr &lexerError;
+    CSTNode *batch[TOKEN_BATCH];
+    size_t index = 0, count = 0;
+};
+
+CSTNode *parsePipelined(const string& input, SymbolTable& symbols, vector<CSTNode*>& tokens) {
+    auto ring = make_unique<TokenRing>();
+    atomic<bool> cancelled = false;
+    exception_ptr lexerError;
+
+    // The producer owns symbols until it is joined
+    thread producer([&] {
+        CSTNode *batch[TOKEN_BATCH];
+        size_t count = 0;
+        try {
+            ScriptLexer lexer(input);
+            while (true) {
+                ScriptToken token = lexer.next();
+                batch[count++] = makeTerminal(token, lexer.tokenOffset(), symbols);
+                if (token.type == CSTTerminalNodeType::END_OF_FILE) {
+                    break;
+                }
+                if (count == TOKEN_BATCH) {
+                    if (!sendTokens(*ring, batch, count, cancelled)) {
+                        for (size_t i = 0; i < count; ++i) {
+                            delete batch[i];
+                        }
+                        return;
+                    }
+                    count = 0;
+                }
+            }
+        } catch (...) {
+            lexerError = current_exception();  // Published to the consumer by the ring
+            batch[count++] = nullptr;
+        }
+        if (!sendTokens(*ring, batch, count, cancelled)) {
+            for (size_t i = 0; i < count; ++i) {
+                delete batch[i];
+            }
+        }
+    });
+
+    RingLexer lexer(*ring, tokens, lexerError);
+    CSTBuilder<CSTNode, CSTNodeType> builder;
+    LRDriver<ParserTables, RingLexer, decltype(builder)> driver(lexer, builder);
+    // Stops the producer, then frees whatever it sent that was never parsed
+    auto abandon = [&] {
+        cancelled = true;
+        producer.join();
+        lexer.discard();
+        CSTNode *rest[TOKEN_BATCH];
+        while (size_t n = ring->tryPop(rest, TOKEN_BATCH)) {
+            for (size_t i = 0; i < n; ++i) {
+                delete rest[i];
+            }
+        }
+    };
+    try {
+        CSTNode *root = driver.parse();
+        producer.join();
+        return root;
+    } catch (const LRSyntaxError &error) {
+        abandon();
+        throw syntaxErrorAt(error, static_cast<CSTTerminalNode *>(tokens.back())->offset);
+    } catch (...) {
+        abandon();
+        throw;
+    }
+}
+
+ScriptParser::ScriptParser() : automaton(builder) {}
+
+void ScriptParser::reset() {
+    root = nullptr;
+    automaton.reset();
+    builder.release();
+    terminals.clear();
+    symbolTable.clear();
+    astArena.rewind();
+}
+
+CSTNode *ScriptParser::parse(string_view source) {
+    reset();
+    ScriptLexer lexer(source);
+    try {
+        while (true) {
+            ScriptToken token = lexer.next();
+            if (terminals.size() == terminalPool.size()) {
+                terminalPool.push_back(make_unique<CSTTerminalNode>(token.type));
+            }
+            CSTTerminalNode *terminal = terminalPool[terminals.size()].get();
+            setTerminal(*terminal, token, lexer.tokenOffset(), symbolTable);
+            terminals.push_back(terminal);
+            if (automaton.push(terminal, token.type)) {
+                break;
+            }
+        }
+    } catch (const LRSyntaxError &error) {
+        throw syntaxErrorAt(error, lexer.tokenOffset());
+    }
+    root = automaton.result();
+    return root;
+}
+
+ASTProgram *ScriptParser::lower() {
+    if (root == nullptr) {
+        throw runtime_error("Nothing has been parsed");
+    }
+    return lowerToAST(root, astArena, symbolTable);
+}
+
+void validate(string_view input) {
+    ScriptLexer lexer(input);
+    RecognizerBuilder<ScriptToken> builder;
+    LRDriver<ParserTables, ScriptLexer, RecognizerBuilder<ScriptToken>> driver(lexer, builder);
+    try {
+        driver.parse();
+    } catch (const LRSyntaxError &error) {
+        throw syntaxErrorAt(error, lexer.tokenOffset());
+    }
+}
+
+// RecognizerBuilder that records syntax errors and recovers from them
+class RecoveringRecognizer : public RecognizerBuilder<ScriptToken> {
+public:
+    RecoveringRecognizer(const ScriptLexer &lexer, vector<SyntaxError> &errors) : lexer(lexer), errors(errors) {}
+
+    Node error(const ScriptToken &, int terminal, span<Node>) {
+        errors.push_back(syntaxErrorAt(ParserTables::terminalNames[terminal], lexer.tokenOffset()));
+        return {};
+    }
+    void skip(Node, const ScriptToken &) {}
+
+private:
+    const ScriptLexer &lexer;
+    vector<SyntaxError> &errors;
+};
+
+void validate(string_view input, vector<SyntaxError> &errors) {
+    ScriptLexer lexer(input);
+    RecoveringRecognizer builder(lexer, errors);
+    LRDriver<ParserTables, ScriptLexer, RecoveringRecognizer> driver(lexer, builder);
+    try {
+        driver.parse();
+    } catch (const LRSyntaxError &error) {
+        throw syntaxErrorAt(error, lexer.tokenOffset());
+    }
+}
+
+string readFile(const string& filename) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        throw runtime_error("Failed to open file: " + filename);
+    }
+    stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
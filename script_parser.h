@@ -0,0 +1,200 @@
+#ifndef SCRIPT_PARSER_H
+#define SCRIPT_PARSER_H
+
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "ast.h"
+#include "cst.h"
+#include "diagnostics.h"
+#include "glr_driver.h"
+#include "lr_driver.h"
+#include "parser.h"
+#include "symbol_table.h"
+
+// Lexer and LR(1) driver for script_grammar, using the tables in parser.h.
+// With verbose set, the token stream and every parser action are traced to
+// stdout. A profile passed to parse() is filled in SCRIPT_PROFILING builds.
+// Lexing and parsing errors are thrown as SyntaxError with the byte offset
+// of the offending token; terminals record their offsets for this.
+
+std::string readFile(const std::string &filename);
+std::vector<CSTNode *> tokenize(const std::string &input, SymbolTable &symbols, bool verbose = false);
+
+// tokenize() without tracing, on up to threadCount threads for inputs of
+// several megabytes or more. The input is split where no token can
+// straddle the cut, and the tokens, offsets and symbol IDs are the same as
+// tokenize() would give.
+std::vector<CSTNode *> tokenizeParallel(const std::string &input, SymbolTable &symbols, size_t threadCount);
+CSTNode* parse(const std::vector<CSTNode *>& input, bool verbose = false, ParseProfile *profile = nullptr);
+
+// parse() that reports every syntax error instead of stopping at the first.
+// Each error is appended to errors and the parse resumes after the next
+// SEMICOLON or RIGHT_BRACE, by the ERROR rules of script_grammar. The tree
+// is returned even so, with an ERROR terminal at each offending token whose
+// children are the nodes and tokens recovery threw away. It cannot be
+// lowered while errors is not empty. Throws SyntaxError only if an error
+// cannot be recovered from.
+CSTNode *parseRecovering(const std::vector<CSTNode *> &input, std::vector<SyntaxError> &errors, bool verbose = false,
+                         ParseProfile *profile = nullptr);
+
+// Lexes on a second thread while parsing on this one. Tokens pass between
+// them in cache-line batches through a bounded lock-free ring, so only a
+// few thousand are ever in flight. Builds the same tree as
+// parse(tokenize(input, symbols, false)) and appends the terminals to
+// tokens for the caller to delete. Throws SyntaxError on a syntax error.
+CSTNode *parsePipelined(const std::string &input, SymbolTable &symbols, std::vector<CSTNode *> &tokens);
+
+// Parses with GLRDriver into a forest allocated in arena. Token i of the
+// forest is input[i]. Throws SyntaxError on a syntax error.
+SPPFNode *parseForest(const std::vector<CSTNode *>& input, Arena &arena);
+
+struct ScriptToken {
+    CSTTerminalNodeType type;
+    std::string_view text;  // Points into the lexer's input
+    int64_t integer = 0;  // Value of a NUMBER
+};
+
+// Streaming lexer that allocates nothing; tokenize() is built on it
+class ScriptLexer {
+public:
+    using Token = ScriptToken;
+
+    // input starts at byte base of the source, for the offsets of tokens
+    explicit ScriptLexer(std::string_view input, size_t base = 0) : input(input), base(base) {}
+
+    // Returns END_OF_FILE tokens once the input is exhausted. Throws
+    // SyntaxError on a NUMBER above INT32_MAX, the largest script int, and
+    // on a character that starts no token.
+    ScriptToken next();
+    static int terminal(const ScriptToken &token) { return token.type; }
+
+    // Offset of the first byte not yet lexed, within input
+    size_t position() const { return index; }
+
+    // Offset in the source of the token next() returned last
+    size_t tokenOffset() const { return base + tokenStart; }
+
+private:
+    std::string_view input;
+    size_t base;
+    size_t index = 0;
+    size_t tokenStart = 0;
+};
+
+// Push parser for source that arrives in pieces, such as reads from a
+// non-blocking socket or pipe. feed() lexes and parses whatever it can and
+// returns when the chunk runs out; the parse then waits in the parser
+// object, not on a thread, until the next chunk. Only a word cut off at the
+// end of a chunk is copied, so one thread can keep many parses in flight.
+//
+// The tree and its terminals are those parse() would build from
+// tokenize(), with spellings interned into symbols.
+class ScriptPushParser {
+public:
+    explicit ScriptPushParser(SymbolTable &symbols);
+
+    // Parses chunk, which need not end on a token boundary and is not
+    // referenced after the call. Throws SyntaxError on a syntax error, with
+    // the offset counted from the start of the first chunk.
+    void feed(std::string_view chunk);
+
+    // Ends the input and returns the CST. Throws SyntaxError if the input
+    // is not a complete program.
+    CSTNode *finish();
+
+    // Every terminal created so far, END_OF_FILE last once finish() has
+    // returned. The caller deletes them, as with tokenize().
+    const std::vector<CSTNode *> &tokens() const { return terminals; }
+
+    // Starts a new parse. Terminals and nonterminals of the previous one
+    // are left to the caller.
+    void reset();
+
+private:
+    void push(const ScriptToken &token, size_t offset);
+
+    SymbolTable &symbols;
+    CSTBuilder<CSTNode, CSTNodeType> builder;
+    LRAutomaton<ParserTables, CSTBuilder<CSTNode, CSTNodeType>> automaton;
+    std::vector<CSTNode *> terminals;
+    std::string partialWord;  // Identifier, keyword or number that may continue in the next chunk
+    size_t partialWordOffset = 0;
+    size_t fed = 0;  // Bytes of every chunk so far
+};
+
+// Lexer, parser and lowering for programs that parse many inputs, such as a
+// service. Every buffer a parse fills is kept for the next one: tokens, CST
+// nodes, the parse stacks, symbols and the AST arena. Once it has seen an
+// input as large as the next, a parser parses it without allocating.
+// Nothing is printed.
+//
+// One instance must not be used by two threads at once. Separate instances
+// share nothing, since the library has no global mutable state, so a parser
+// per thread needs no locking.
+class ScriptParser {
+public:
+    ScriptParser();
+
+    ScriptParser(const ScriptParser &) = delete;
+    ScriptParser &operator=(const ScriptParser &) = delete;
+
+    // Lexes and parses source, forgetting the previous input. The tree and
+    // tokens() stay valid until the next parse() or reset(), and their
+    // spellings are in symbols(). Throws SyntaxError.
+    CSTNode *parse(std::string_view source);
+
+    // Lowers the tree of the last parse() into arena(), valid as long as the
+    // tree. Throws runtime_error as lowerToAST() does.
+    ASTProgram *lower();
+
+    // Every terminal of the last input, END_OF_FILE last
+    const std::vector<CSTNode *> &tokens() const { return terminals; }
+    SymbolTable &symbols() { return symbolTable; }
+    Arena &arena() { return astArena; }
+
+    // Forgets the last input and keeps every buffer
+    void reset();
+
+private:
+    CSTNode *root = nullptr;
+    SymbolTable symbolTable;
+    Arena astArena;
+    PooledCSTBuilder<CSTNode, CSTNodeType> builder;
+    LRAutomaton<ParserTables, PooledCSTBuilder<CSTNode, CSTNodeType>> automaton;
+    std::vector<std::unique_ptr<CSTTerminalNode>> terminalPool;
+    std::vector<CSTNode *> terminals;  // The first terminals.size() of terminalPool
+};
+
+// Parses input without building a tree. onShift(const ScriptToken &) returns
+// the Value of each terminal and onReduce(int rule, std::span<Value> rhs) the
+// Value of the rule's left-hand side, ParserTables::ruleLhs[rule], which is
+// also its CSTNodeType. Returns the Value of the whole program; throws
+// SyntaxError on a syntax error. Memory use is bounded by nesting depth, not
+// input length.
+template <typename Value, typename OnShift, typename OnReduce>
+Value parseWithCallbacks(std::string_view input, OnShift onShift, OnReduce onReduce) {
+    ScriptLexer lexer(input);
+    CallbackBuilder<ScriptToken, Value, OnShift, OnReduce> builder(onShift, onReduce);
+    LRDriver<ParserTables, ScriptLexer, decltype(builder)> driver(lexer, builder);
+    try {
+        return driver.parse();
+    } catch (const LRSyntaxError &error) {
+        throw SyntaxError(std::string("Unexpected ") + error.terminalName, lexer.tokenOffset());
+    }
+}
+
+// Checks that input is a syntactically valid script at raw automaton speed.
+// Throws SyntaxError on a syntax error.
+void validate(std::string_view input);
+
+// validate() that appends every syntax error to errors, recovering as
+// parseRecovering() does. Throws SyntaxError only on a lexing error or if
+// an error cannot be recovered from.
+void validate(std::string_view input, std::vector<SyntaxError> &errors);
+
+#endif // SCRIPT_PARSER_H
@@ -0,0 +1,68 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+// Bounded lock-free queue from exactly one producer thread to exactly one
+// consumer thread. Items move in batches: each side copies a whole batch and
+// then publishes it with a single release store of its index, so the shared
+// cache lines change hands once per batch rather than once per item. Each
+// side also keeps its last view of the other's index and only reloads it
+// when the ring looks full or empty.
+//
+// Neither side ever waits; a tryPush() or tryPop() that moves nothing
+// returns 0 and the caller decides how to back off.
+template <typename T, size_t Capacity>
+class SPSCRing {
+    static_assert(std::has_single_bit(Capacity), "Capacity must be a power of two");
+
+public:
+    // Items in one cache line, the natural batch size
+    static constexpr size_t CACHE_LINE_ITEMS = std::max<size_t>(64 / sizeof(T), 1);
+
+    // Producer only. Copies as many of items as fit and returns how many.
+    size_t tryPush(const T *items, size_t count) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (Capacity - (tail - cachedHead) < count) {
+            cachedHead = head.load(std::memory_order_acquire);
+        }
+        size_t n = std::min(count, Capacity - (tail - cachedHead));
+        for (size_t i = 0; i < n; ++i) {
+            slots[(tail + i) & (Capacity - 1)] = items[i];
+        }
+        if (n != 0) {
+            this->tail.store(tail + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // Consumer only. Moves up to count items into items and returns how many.
+    size_t tryPop(T *items, size_t count) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (cachedTail - head < count) {
+            cachedTail = tail.load(std::memory_order_acquire);
+        }
+        size_t n = std::min(count, cachedTail - head);
+        for (size_t i = 0; i < n; ++i) {
+            items[i] = slots[(head + i) & (Capacity - 1)];
+        }
+        if (n != 0) {
+            this->head.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+private:
+    // Indexes count every item ever pushed or popped and are reduced modulo
+    // Capacity only to address a slot. Each side's lines are its own.
+    alignas(64) std::atomic<size_t> head = 0;  // Written by the consumer
+    size_t cachedTail = 0;
+    alignas(64) std::atomic<size_t> tail = 0;  // Written by the producer
+    size_t cachedHead = 0;
+    alignas(64) T slots[Capacity];
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,72 @@
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+SymbolTable::SymbolTable() : slots(64, INVALID_SYMBOL) {}
+
+// FNV-1a; identifiers are short, so a simple byte loop is enough
+uint32_t SymbolTable::hash(std::string_view name) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Returns the slot holding name, or the empty slot where it would be inserted
+size_t SymbolTable::findSlot(std::string_view name, uint32_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != INVALID_SYMBOL) {
+        const Entry &entry = entries[slots[slot]];
+        if (entry.hash == hash && entry.name == name) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+uint32_t SymbolTable::lookup(std::string_view name) const {
+    return slots[findSlot(name, hash(name))];
+}
+
+uint32_t SymbolTable::intern(std::string_view name) {
+    uint32_t h = hash(name);
+    size_t slot = findSlot(name, h);
+    if (slots[slot] != INVALID_SYMBOL) {
+        return slots[slot];
+    }
+
+    uint32_t symbol = entries.size();
+    char *data = static_cast<char *>(bytes.allocate(name.size(), 1));
+    std::memcpy(data, name.data(), name.size());
+    entries.push_back({std::string_view(data, name.size()), h});
+    slots[slot] = symbol;
+
+    // Keep the load factor at or below one half so probe sequences stay short
+    if (entries.size() * 2 > slots.size()) {
+        grow();
+    }
+    return symbol;
+}
+
+void SymbolTable::clear() {
+    entries.clear();
+    std::fill(slots.begin(), slots.end(), INVALID_SYMBOL);
+    bytes.rewind();
+}
+
+void SymbolTable::grow() {
+    slots.assign(slots.size() * 2, INVALID_SYMBOL);
+    size_t mask = slots.size() - 1;
+    for (uint32_t symbol = 0; symbol < entries.size(); ++symbol) {
+        size_t slot = entries[symbol].hash & mask;
+        while (slots[slot] != INVALID_SYMBOL) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = symbol;
+    }
+}
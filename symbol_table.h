@@ -0,0 +1,53 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+
+// Interns identifier spellings so that each distinct name is stored once and
+// can be compared or hashed by its 32-bit symbol ID.
+//
+// Names are copied into a byte arena, so the views returned by name() stay
+// valid for the lifetime of the table. Lookup is an open-addressing hash table
+// with linear probing over the symbol IDs.
+class SymbolTable {
+public:
+    static constexpr uint32_t INVALID_SYMBOL = UINT32_MAX;
+
+    SymbolTable();
+
+    // Returns the ID of name, adding it to the table if it is not present yet
+    uint32_t intern(std::string_view name);
+
+    // Returns the ID of name, or INVALID_SYMBOL if it has never been interned
+    uint32_t lookup(std::string_view name) const;
+
+    // Forgets every symbol, keeping the memory for the next ones. Views
+    // returned by name() dangle afterwards.
+    void clear();
+
+    std::string_view name(uint32_t symbol) const { return entries[symbol].name; }
+    size_t size() const { return entries.size(); }
+
+    // Number of bytes of name storage handed out by the arena
+    size_t bytesUsed() const { return bytes.bytesUsed(); }
+
+private:
+    struct Entry {
+        std::string_view name;
+        uint32_t hash;
+    };
+
+    static uint32_t hash(std::string_view name);
+    size_t findSlot(std::string_view name, uint32_t hash) const;
+    void grow();
+
+    std::vector<Entry> entries;  // Symbol ID -> spelling
+    std::vector<uint32_t> slots;  // Hash slot -> symbol ID, or INVALID_SYMBOL if empty
+    Arena bytes;  // Backing storage for the spellings
+};
+
+#endif // SYMBOL_TABLE_H